@@ -0,0 +1,92 @@
+#pragma once
+
+#include "latency_stat.h"
+#include <rpos/system/io/i_stream.h>
+#include <rpos/system/io/segmented_loop_files_write_stream.h>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Write behind buffering in front of segmented loop files, whose writes and flushes block on the
+    // storage. Producers copy into one of a few preallocated buffers, a dedicated io thread writes the
+    // full ones to the segments in a single write each, so segment rotation and file removal happen on
+    // it too, and flushes the segments at most once per flush interval.
+    //
+    // A write is never split across buffers: the segments, which only split between writes, still
+    // split between the frames written here. Producers block, and the stall is counted, when every
+    // buffer is waiting for the io thread.
+    class AsyncSegmentedWriteStream : public rpos::system::io::IStream
+    {
+    public:
+        struct Options
+        {
+            size_t bufferSize;              // in bytes
+            size_t bufferCount;
+            std::int64_t flushInterval;     // in us, buffered data also reaches the segments within it
+        };
+
+    public:
+        AsyncSegmentedWriteStream(boost::shared_ptr<rpos::system::io::SegmentedLoopFilesWriteStream> target, const Options& options);
+        virtual ~AsyncSegmentedWriteStream();
+
+        virtual bool isOpen();
+        virtual bool canRead();
+        virtual bool canWrite();
+        virtual bool canSeek();
+
+        // writes out and flushes everything buffered, the target stays open for its owner to close
+        virtual void close();
+
+        virtual bool endOfStream();
+
+        virtual int read(void* buffer, size_t size);
+        virtual int write(const void* buffer, size_t size);
+        virtual size_t tell();
+        virtual void seek(rpos::system::io::SeekType type, int offset);
+
+        // since the previous call: written bytes, cost of the segment writes and of the producer stalls in us
+        std::uint64_t takeWrittenBytes() { return writtenBytes_.exchange(0, std::memory_order_relaxed); }
+        std::uint64_t takeFlushes() { return flushes_.exchange(0, std::memory_order_relaxed); }
+        LatencyStat::Summary takeWriteCost() { return writeCost_.takeSummary(); }
+        LatencyStat::Summary takeStalls() { return stalls_.takeSummary(); }
+
+    private:
+        struct Buffer
+        {
+            std::vector<std::uint8_t> data;
+            size_t size;
+        };
+
+        void submitActive_();
+        void ioThread_();
+
+    private:
+        boost::shared_ptr<rpos::system::io::SegmentedLoopFilesWriteStream> target_;
+        Options options_;
+
+        std::mutex lock_;
+        std::condition_variable ioSignal_;
+        std::condition_variable freeSignal_;
+        std::vector<std::unique_ptr<Buffer> > buffers_;
+        std::deque<Buffer*> freeBuffers_;
+        std::deque<Buffer*> fullBuffers_;
+        Buffer* active_;                    // filled by the producers, null until the first write
+        bool working_;
+        size_t accepted_;
+        std::thread ioWorker_;
+
+        std::atomic<std::uint64_t> writtenBytes_;
+        std::atomic<std::uint64_t> flushes_;
+        LatencyStat writeCost_;
+        LatencyStat stalls_;
+    };
+
+}}}
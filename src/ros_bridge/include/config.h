@@ -1,7 +1,12 @@
 #pragma once
+#include "scan_converter.h"
 #include <string>
+#include <vector>
 
+// 0 builds the ROS free tools, such as the session replay
+#ifndef ROS_DISTRO_VERSION
 #define ROS_DISTRO_VERSION 1
+#endif
 
 #if ROS_DISTRO_VERSION == 1
 #include <ros/ros.h>
@@ -12,18 +17,72 @@ namespace rp { namespace slamware { namespace utils {
     enum MsgType
     {
         MsgTypeScan,
+        MsgTypeMultiEchoScan,
         MsgTypeOdometry,
         MsgTypeDeadreckon,
+        MsgTypeImu,
+        MsgTypeRange,
+        MsgTypeBattery,
+        MsgTypeDock,
         MsgTypeVelocity
     };
 
+    enum VelocityOutput
+    {
+        VelocityOutputTwist,            // geometry_msgs::Twist
+        VelocityOutputTwistStamped,     // geometry_msgs::TwistStamped, stamped with the request time
+        VelocityOutputWheels            // sensor_msgs::JointState, velocity of (left_wheel, right_wheel) in m/s
+    };
+
     struct RosNodeConfig
     {
         std::string scan_sub_topic;
+        bool is_multi_echo_scan;
+        EchoSelection echo_selection;
         std::string odometry_sub_topic;
         std::string velocity_pub_topic;
+        VelocityOutput velocity_output;
+        double wheel_span;              // in meter, distance between the left and right wheels
         bool is_accumulated_odometry;
+        std::string imu_sub_topic;      // empty to disable the IMU device
+        bool enable_imu_fusion;         // fuse the IMU yaw rate into the accumulated odometry
+        double imu_fusion_time_constant;    // in second, how slowly the fused yaw is pulled back to the odometry yaw
+        std::vector<std::string> range_sub_topics;     // the index in the list is the extended sensor id
+        double range_timeout;           // in second, older range data is reported as invalid
+        std::string battery_sub_topic;  // empty to report a full battery
+        std::string dock_sub_topic;     // empty to report not docked
         bool enable_shared_memory_lidar;
+        double stats_report_interval;   // in second, 0 to disable
+        double clock_sync_interval;     // in second, how often the ros to steady clock offset is resampled, 0 to disable
+        bool use_sim_time;              // follows the global /use_sim_time, the time base becomes /clock and the heartbeat steps with it
+
+        // scale down cmd_vel against the latest scan before publishing
+        bool reflex_stop_enabled;
+        double reflex_robot_radius;
+        double reflex_stop_margin;
+        double reflex_deceleration;
+        double reflex_reaction_time;
+        double reflex_scan_timeout;     // in second, older scans do not guard
+        double reflex_laser_yaw;        // in radian, yaw of the laser frame in base_link
+
+        // record what is handed to the pseudo devices, for offline replay
+        std::string record_path;        // parent directory of the recordings, empty to disable
+        int record_segment_size;        // in MB
+        int record_space_limit;         // in MB per recording, the oldest segments are removed past this
+        int record_queue_size;          // records waiting for the writer thread, the newest are dropped past this
+        bool record_compact_scan;       // quantized and delta coded scans, about a tenth of the plain serialization
+        int record_write_buffer_size;   // in KB, the io thread writes a full buffer at once
+        int record_write_buffers;       // the writer thread stalls when all of them wait for the io thread
+        double record_flush_interval;   // in second, how often the segments are flushed
+
+        // keep the last seconds of the same messages in memory, dumped on anomalies or on the dump_flight_recorder service
+        std::string flight_recorder_path;       // parent directory of the dumps, empty to disable
+        double flight_recorder_duration;        // in second
+        int flight_recorder_size;               // in MB, memory of the ring
+        double flight_recorder_scan_gap;        // in second, dump when scans stop for this long, 0 to disable
+        double flight_recorder_client_gap;      // in second, dump when slamware stops fetching odometry for this long, 0 to disable
+        double flight_recorder_odometry_jump;   // in meter, dump on a longer odometry step between two fetches, 0 to disable
+        double flight_recorder_rotation_jump;   // in rad, dump on a larger odometry turn between two fetches, 0 to disable
         
         RosNodeConfig();
         void resetToDefault();
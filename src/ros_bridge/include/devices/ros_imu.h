@@ -0,0 +1,24 @@
+#pragma once
+
+#include <rp/slamware/utils/pseudo_cp0_device.h>
+#include <boost/shared_ptr.hpp>                 
+#include <boost/weak_ptr.hpp>
+
+namespace rp { namespace slamware { namespace utils {
+
+    class DevicesManagerService;
+
+    class RosImuDevice
+        : public PseudoCp0Device
+    {
+    public:
+        explicit RosImuDevice(boost::shared_ptr<DevicesManagerService> deviceManager);
+        ~RosImuDevice();
+
+    protected:
+        virtual void getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData);
+
+    private:
+        boost::weak_ptr<DevicesManagerService> deviceManager_;
+    };
+}}}
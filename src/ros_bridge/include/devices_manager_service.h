@@ -6,6 +6,7 @@
 #include <rpos/rpos.h>
 #include <rp/slamware/utils/pseudo_device.h>
 #include <rp/slamware/utils/pseudo_base_device.h>
+#include <rp/slamware/utils/pseudo_cp0_device.h>
 #include <boost/shared_ptr.hpp>
 #include <atomic>
 #include <thread>
@@ -26,6 +27,9 @@ namespace rp { namespace slamware { namespace utils {
         bool getScanData(rpos::message::lidar::LidarScan& lidarData);
         void publishMotion(const rpos::message::base::MotionRequest& request);
         void getMovementEstimation(rpos::message::Message<rpos::message::base::MovementEstimation>& estimation);
+        void getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData);
+        void getExtendedSensorData(std::vector<PseudoBaseDevice::BaseSensorData>& extendedSensorData);
+        void getBaseStatus(PseudoBaseDevice::BaseStatusData& data);
 
     private:
         void workThread_();
@@ -44,6 +48,7 @@ namespace rp { namespace slamware { namespace utils {
 
         boost::shared_ptr<PseudoRPLidarDevice> lidar_;
         boost::shared_ptr<PseudoBaseDevice> base_;
+        boost::shared_ptr<PseudoCp0Device> imu_;
     };
 
 }}}
\ No newline at end of file
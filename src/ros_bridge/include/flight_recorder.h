@@ -0,0 +1,115 @@
+#pragma once
+
+#include "session_stream.h"
+#include <rpos/message/message.h>
+#include <rpos/message/lidar_messages.h>
+#include <rpos/message/base_messages.h>
+#include <rpos/system/io/snapshot_loop_buffer_memory_write_stream.h>
+#include <rpos/system/util/log.h>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Black box of the bridge: the last seconds of recorded messages are kept serialized in a memory
+    // ring, and written to disk only when something goes wrong. Dumps use the session recording layout,
+    // so they can be replayed like a full recording.
+    //
+    // Everything but requestDump() runs on the session recorder writer thread. A dump only takes a
+    // snapshot of the ring there, which shares its buffers, the file is written on the dump thread.
+    //
+    // Automatic triggers, all times in us:
+    //  - scan gap: consecutive scans further apart than scanGap, or no scan for scanGap
+    //  - client gap: slamware stopped fetching movement estimations for clientGap, taken as a disconnect
+    //  - odometry jump: a movement estimation longer than odometryJump (m) or turning more than rotationJump (rad)
+    class FlightRecorder
+    {
+    public:
+        struct Options
+        {
+            std::string path;               // parent directory of the dumps, empty to disable
+            std::int64_t duration;          // in us, how far back a dump goes
+            size_t capacity;                // in bytes, the ring may hold less than duration past this
+            std::int64_t scanGap;           // 0 to disable
+            std::int64_t clientGap;         // 0 to disable
+            float odometryJump;             // 0 to disable
+            float rotationJump;             // 0 to disable
+        };
+
+    public:
+        FlightRecorder();
+        ~FlightRecorder();
+
+        bool start(const Options& options);
+        // writes out the dumps already taken
+        void stop();
+        bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+        // thread safe, taken on the next poll of the writer thread
+        void requestDump(const std::string& reason);
+
+        void write(const char* topic, const rpos::message::Message<rpos::message::lidar::LidarScan>& scan);
+        void write(const char* topic, const rpos::message::Message<rpos::message::base::MovementEstimation>& estimation);
+        void write(const char* topic, const rpos::message::Message<rpos::message::base::MotionRequest>& request);
+        // checks the idle triggers and takes the requested dumps
+        void poll();
+
+    private:
+        // ring position of the first frame written at or after time
+        struct Mark
+        {
+            std::int64_t time;
+            std::uint64_t offset;
+        };
+
+        struct Dump
+        {
+            rpos::system::io::SnapshotLoopBufferMemoryWriteStream::Snapshot snapshot;
+            size_t offset;              // of the first frame within the window
+            std::string name;           // directory name, trigger time and reason
+        };
+
+        template <typename PayloadT>
+        void append_(const char* topic, const rpos::message::Message<PayloadT>& message);
+        void trigger_(const char* reason);
+        void takeDump_(const std::string& reason);
+        void dumpThread_();
+        void writeDump_(const Dump& dump);
+
+    private:
+        static rpos::system::util::LogScope logger;
+
+        Options options_;
+        std::atomic<bool> enabled_;
+
+        // owned by the writer thread
+        boost::shared_ptr<rpos::system::io::SnapshotLoopBufferMemoryWriteStream> ring_;
+        boost::shared_ptr<SessionWriteStream> writer_;
+        std::deque<Mark> marks_;
+        std::int64_t lastTimestamp_;
+        std::int64_t lastScanTimestamp_;
+        std::int64_t lastScanArrival_;
+        std::int64_t lastEstimationArrival_;
+        bool scanStalled_;
+        bool clientStalled_;
+        std::int64_t lastAutoDump_;
+        std::uint32_t dumpSequence_;    // tells apart the dumps taken within the same millisecond
+
+        std::atomic<bool> dumpRequested_;
+        std::mutex requestLock_;
+        std::string requestReason_;
+
+        std::mutex dumpLock_;
+        std::condition_variable dumpSignal_;
+        std::deque<Dump> dumps_;
+        bool dumpWorking_;
+        std::thread dumpWorker_;
+    };
+
+}}}
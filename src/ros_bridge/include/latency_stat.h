@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Lock-free duration accumulator, pushed from the hot path and drained by the stats reporter.
+    // The unit is up to the caller.
+    class LatencyStat
+    {
+    public:
+        struct Summary
+        {
+            std::uint64_t count;
+            double average;
+            std::int64_t max;
+        };
+
+    public:
+        LatencyStat()
+            : count_(0), sum_(0), max_(0)
+        {}
+
+        void push(std::int64_t value)
+        {
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(value, std::memory_order_relaxed);
+            std::int64_t currentMax = max_.load(std::memory_order_relaxed);
+            while (value > currentMax && !max_.compare_exchange_weak(currentMax, value, std::memory_order_relaxed))
+            {
+                //
+            }
+        }
+
+        // summary since the previous call
+        Summary takeSummary()
+        {
+            Summary summary;
+            summary.count = count_.exchange(0, std::memory_order_relaxed);
+            std::int64_t sum = sum_.exchange(0, std::memory_order_relaxed);
+            summary.max = max_.exchange(0, std::memory_order_relaxed);
+            summary.average = summary.count ? double(sum) / summary.count : 0.0;
+            return summary;
+        }
+
+    private:
+        std::atomic<std::uint64_t> count_;
+        std::atomic<std::int64_t> sum_;
+        std::atomic<std::int64_t> max_;
+    };
+
+    // Lock-free fixed bucket latency histogram (1 ms buckets up to 1 s), drained by the stats reporter
+    class LatencyHistogram
+    {
+    public:
+        static const int BucketCount = 1000;
+
+        struct Summary
+        {
+            std::uint64_t count;
+            std::uint64_t overflow;     // samples of 1 s or longer
+            int p50Ms;
+            int p90Ms;
+            int p99Ms;
+            int maxMs;
+        };
+
+    public:
+        LatencyHistogram()
+            : overflow_(0)
+        {
+            for (int i = 0; i < BucketCount; i++)
+                buckets_[i].store(0, std::memory_order_relaxed);
+        }
+
+        void push(std::int64_t us)
+        {
+            std::int64_t ms = us / 1000;
+            if (ms < 0)
+                ms = 0;
+            if (ms >= BucketCount)
+                overflow_.fetch_add(1, std::memory_order_relaxed);
+            else
+                buckets_[ms].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // summary since the previous call, percentiles are the upper edge of the bucket in ms
+        Summary takeSummary()
+        {
+            std::uint32_t counts[BucketCount];
+            Summary summary;
+            summary.count = 0;
+            summary.overflow = overflow_.exchange(0, std::memory_order_relaxed);
+            summary.maxMs = 0;
+            for (int i = 0; i < BucketCount; i++)
+            {
+                counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+                summary.count += counts[i];
+                if (counts[i])
+                    summary.maxMs = i + 1;
+            }
+            summary.count += summary.overflow;
+            if (summary.overflow)
+                summary.maxMs = BucketCount;
+
+            summary.p50Ms = percentile_(counts, summary.count, 0.5);
+            summary.p90Ms = percentile_(counts, summary.count, 0.9);
+            summary.p99Ms = percentile_(counts, summary.count, 0.99);
+            return summary;
+        }
+
+    private:
+        static int percentile_(const std::uint32_t* counts, std::uint64_t total, double ratio)
+        {
+            if (!total)
+                return 0;
+            std::uint64_t rank = std::uint64_t(std::ceil(total * ratio));
+            std::uint64_t accumulated = 0;
+            for (int i = 0; i < BucketCount; i++)
+            {
+                accumulated += counts[i];
+                if (accumulated >= rank)
+                    return i + 1;
+            }
+            return BucketCount;
+        }
+
+    private:
+        std::atomic<std::uint32_t> buckets_[BucketCount];
+        std::atomic<std::uint64_t> overflow_;
+    };
+
+}}}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Single writer, multiple readers latest value slot (seqlock).
+    // The writer never waits, readers retry only while a store is in progress,
+    // so both sides run in constant time without sharing a mutex.
+    template <typename T>
+    class LatestSlot
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "LatestSlot requires a trivially copyable type");
+
+    public:
+        LatestSlot()
+            : sequence_(0)
+        {
+            std::memset(&value_, 0, sizeof(value_));
+        }
+
+        void store(const T& value)
+        {
+            std::uint32_t seq = sequence_.load(std::memory_order_relaxed);
+            sequence_.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(&value_, &value, sizeof(T));
+            sequence_.store(seq + 2, std::memory_order_release);
+        }
+
+        // returns the sequence of the value read, 0 means nothing has been stored yet
+        std::uint32_t load(T& value) const
+        {
+            std::uint32_t before, after;
+            do
+            {
+                before = sequence_.load(std::memory_order_acquire);
+                std::memcpy(&value, &value_, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = sequence_.load(std::memory_order_relaxed);
+            } while ((before & 1) || before != after);
+            return before / 2;
+        }
+
+        std::uint32_t sequence() const
+        {
+            return sequence_.load(std::memory_order_acquire) / 2;
+        }
+
+    private:
+        std::atomic<std::uint32_t> sequence_;
+        T value_;
+    };
+
+}}}
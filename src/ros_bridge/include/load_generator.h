@@ -0,0 +1,87 @@
+#pragma once
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/Imu.h>
+#include <nav_msgs/Odometry.h>
+#include <geometry_msgs/Vector3Stamped.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Publishes synthetic scan, odometry (or deadreckon) and IMU streams for load testing.
+    // The robot drives a circle in a walled room with a pillar, scans are ray cast against it,
+    // every stream gets sensor noise and its own publish jitter.
+    class LoadGenerator
+    {
+    public:
+        struct Config
+        {
+            std::string scanTopic;
+            std::string odometryTopic;
+            std::string imuTopic;           // empty to disable
+            bool accumulatedOdometry;       // nav_msgs::Odometry, otherwise geometry_msgs::Vector3Stamped increments
+            int beams;
+            double scanRate;                // in Hz, 0 to disable
+            double odometryRate;            // in Hz, 0 to disable
+            double imuRate;                 // in Hz, 0 to disable
+            double jitter;                  // standard deviation of the publish delay, as a ratio of the period
+            bool markScans;                 // the last beam of every scan carries its sequence number
+        };
+
+        // called right before a scan is published, with its sequence number and the steady time in us
+        typedef std::function<void(int, std::int64_t)> ScanPublishedCallback;
+
+        static const int MarkerModulo = 4096;
+
+    public:
+        LoadGenerator(ros::NodeHandle& nh, const Config& config);
+        ~LoadGenerator();
+
+        void setScanPublishedCallback(const ScanPublishedCallback& callback) { scanPublished_ = callback; }
+        // restarts the streams at the given rates
+        void start(double scanRate, double odometryRate, double imuRate);
+        void stop();
+
+        // the angle in degree the marker beam has once converted by the bridge
+        float markerAngle() const;
+        static float markerRange(int id);
+        static int markerId(float range);     // -1 if the range is not a marker
+
+    private:
+        struct Pose
+        {
+            double x;
+            double y;
+            double yaw;
+            double v;
+            double omega;
+        };
+
+        template <typename FillT>
+        void streamThread_(double rate, int seed, FillT fill);
+        Pose poseAt_(double t) const;
+        float castRay_(double x, double y, double rad) const;
+        void fillScan_(sensor_msgs::LaserScan& msg, double t, int id, std::mt19937& rng);
+        void fillOdometry_(nav_msgs::Odometry& msg, double t, std::mt19937& rng);
+        void fillDeadReckon_(geometry_msgs::Vector3Stamped& msg, double t, double dt, std::mt19937& rng);
+        void fillImu_(sensor_msgs::Imu& msg, double t, std::mt19937& rng);
+
+    private:
+        Config config_;
+        ros::Publisher pubScan_;
+        ros::Publisher pubOdometry_;
+        ros::Publisher pubImu_;
+        ScanPublishedCallback scanPublished_;
+        std::int64_t startTime_;    // steady time in us of t = 0 of the trajectory
+        std::atomic<bool> working_;
+        std::vector<std::thread> workers_;
+    };
+
+}}}
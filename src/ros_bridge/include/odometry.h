@@ -0,0 +1,74 @@
+#pragma once
+
+#include "se2_pose.h"
+#include <cstdint>
+#include <vector>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // deadreckon increments as structure of arrays, integrated in one batch on fetch
+    struct DeadReckonIncrements
+    {
+        std::vector<float> dx;
+        std::vector<float> dy;
+        std::vector<float> dyaw;
+
+        size_t size() const { return dx.size(); }
+        void push_back(float x, float y, float yaw) { dx.push_back(x); dy.push_back(y); dyaw.push_back(yaw); }
+        void clear() { dx.clear(); dy.clear(); dyaw.clear(); }
+        void swap(DeadReckonIncrements& that) { dx.swap(that.dx); dy.swap(that.dy); dyaw.swap(that.dyaw); }
+
+        // the composed increments, scratch is reused across calls
+        Se2Pose integrate(std::vector<float>& scratch) const
+        {
+            return Se2Pose::integrate(dx.data(), dy.data(), dyaw.data(), size(), scratch);
+        }
+    };
+
+    // Turns accumulated poses into the movement since the previous one, in the previous pose frame
+    class PoseDelta
+    {
+    public:
+        PoseDelta()
+            : initialized_(false)
+        {}
+
+        // the first pose only sets the reference and gives an identity delta
+        Se2Pose next(const Se2Pose& pose)
+        {
+            Se2Pose delta;
+            if (initialized_)
+                delta = previous_.inverseTimes(pose);
+            initialized_ = true;
+            previous_ = pose;
+            return delta;
+        }
+
+    private:
+        bool initialized_;
+        Se2Pose previous_;
+    };
+
+    // Wheel odometry / gyro complementary filter. The fused pose follows the odometry translation,
+    // its yaw integrates the gyro and is pulled back towards the odometry yaw with the time constant
+    // to cancel the gyro bias.
+    class YawFusion
+    {
+    public:
+        explicit YawFusion(double timeConstant);
+
+        // gyroYaw is the integrated gyro yaw in radian, now in us,
+        // returns false until the first step has set the references
+        bool step(const Se2Pose& odom, double gyroYaw, std::int64_t now);
+        const Se2Pose& fused() const { return fused_; }
+
+    private:
+        double timeConstant_;
+        bool initialized_;
+        Se2Pose preOdom_;
+        Se2Pose fused_;
+        double preGyroYaw_;
+        std::int64_t lastStepTime_;
+    };
+
+}}}
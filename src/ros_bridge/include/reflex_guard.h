@@ -0,0 +1,55 @@
+#pragma once
+
+#include "latest_slot.h"
+#include <cstdint>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Keeps the latest scan as per sector minimum ranges and scales the linear velocity of a
+    // motion command down to what can still be stopped before the nearest obstacle on its path.
+    // The scan side is single writer (the scan callback), checks cost O(sectors) per command.
+    class ReflexGuard
+    {
+    public:
+        static const int SectorCount = 72;
+
+        struct Config
+        {
+            float robotRadius;          // in meter
+            float stopMargin;           // in meter, kept between the robot and the obstacle
+            float deceleration;         // in m/s^2
+            float reactionTime;         // in second
+            std::int64_t scanTimeout;   // in us, older scans do not guard
+            float laserYaw;             // in radian, yaw of the laser frame in the base frame
+        };
+
+    public:
+        ReflexGuard();
+
+        void configure(const Config& config) { config_ = config; }
+
+        void beginScan();
+        // rad is the angle of the ROS scan, counter-clockwise from the laser x axis, in any range.
+        // The sectors are in the base frame, 0 is the front of the robot.
+        void addPoint(float rad, float dist);
+        void commitScan(std::int64_t timestamp);
+
+        // returns the scale to apply to the linear velocity, in [0, 1]
+        float speedScale(float vx, float vy, std::int64_t now) const;
+
+    private:
+        struct Sectors
+        {
+            float minRange[SectorCount];
+            std::int64_t timestamp;
+        };
+
+    private:
+        Config config_;
+        float sectorCos_[SectorCount];
+        float sectorSin_[SectorCount];
+        Sectors building_;
+        LatestSlot<Sectors> sectors_;
+    };
+
+}}}
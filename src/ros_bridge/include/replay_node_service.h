@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ros_node_service.h"
+#include "se2_pose.h"
+#include "session_reader.h"
+#include <rpos/context/base_service.h>
+#include <boost/enable_shared_from_this.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Stands in for the ros node: feeds a SessionRecorder recording to the pseudo devices, so the
+    // bridge server and slamware run as usual without ROS. Scans go to the lidar device in recorded
+    // order, movement estimations are composed until slamware fetches them, recorded motion
+    // requests are only counted against the live ones.
+    class ReplayNodeService
+        : public IRosNode
+        , public boost::enable_shared_from_this<ReplayNodeService>
+        , public rpos::context::BaseService<IRosNode>
+    {
+    public:
+        struct Options
+        {
+            std::string directory;
+            double rate;                // 1 for real time, N times faster, 0 as fast as possible
+            double startDelay;          // in second, after the devices are registered, for slamware to connect
+        };
+
+        struct Summary
+        {
+            std::uint64_t scans;
+            std::uint64_t estimations;
+            std::uint64_t recordedMotions;
+            std::uint64_t liveMotions;
+            std::int64_t recordedDuration;      // in us
+            std::int64_t replayDuration;        // in us
+        };
+
+    public:
+        explicit ReplayNodeService(const Options& options);
+        virtual ~ReplayNodeService();
+
+        virtual bool onStart();
+        virtual bool onStop();
+
+        // blocks until the recording has been replayed
+        virtual void spin();
+        virtual bool getLaserScan(rpos::message::lidar::LidarScan& lidarData);
+        virtual void publishMotion(const rpos::message::base::MotionRequest& request);
+        virtual void getMovementEstimation(rpos::message::Message<rpos::message::base::MovementEstimation>& estimation);
+        virtual void getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData);
+        virtual void getExtendedSensorData(std::vector<PseudoBaseDevice::BaseSensorData>& extendedSensorData);
+        virtual void getBaseStatus(PseudoBaseDevice::BaseStatusData& data);
+        virtual void registerLidarDevice(boost::shared_ptr<PseudoRPLidarDevice> lidarDevice);
+        virtual void registerBaseDevice(boost::shared_ptr<PseudoBaseDevice> baseDevice);
+        virtual const RosNodeConfig& config() { return config_; }
+        virtual void reportStats();
+        virtual void sleepFor(std::int64_t us);
+
+        Summary summary() const;
+
+    private:
+        void replayThread_();
+        // waits until the steady time in us, false if stopped meanwhile
+        bool waitUntil_(std::int64_t steadyTime);
+
+    private:
+        Options options_;
+        RosNodeConfig config_;
+        SessionReader reader_;
+
+        std::mutex lock_;
+        std::condition_variable signal_;
+        bool working_;
+        bool finished_;
+        boost::shared_ptr<PseudoRPLidarDevice> lidarDevice_;
+        boost::shared_ptr<PseudoBaseDevice> baseDevice_;
+        std::thread replayWorker_;
+
+        // composed since the previous fetch, guarded by estimationLock_
+        std::mutex estimationLock_;
+        Se2Pose pendingEstimation_;
+        std::uint64_t estimationTimestamp_;     // steady time in us
+
+        std::atomic<std::uint64_t> scans_;
+        std::atomic<std::uint64_t> estimations_;
+        std::atomic<std::uint64_t> recordedMotions_;
+        std::atomic<std::uint64_t> liveMotions_;
+        std::atomic<std::int64_t> recordedDuration_;
+        std::atomic<std::int64_t> replayDuration_;
+    };
+
+}}}
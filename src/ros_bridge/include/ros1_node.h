@@ -1,20 +1,40 @@
 #pragma once
 
 #include "config.h"
+#include "latest_slot.h"
+#include "latency_stat.h"
+#include "odometry.h"
+#include "reflex_guard.h"
+#include "scan_converter.h"
+#include "se2_pose.h"
+#include "session_recorder.h"
 #include <rp/slamware/utils/pseudo_rplidar_device.h>
 #include <rp/slamware/utils/pseudo_base_device.h>
 #include <rpos/message/lidar_messages.h>
 #include <rpos/message/base_messages.h>
+#include <rpos/message/imu_messages.h>
 #include <rpos/system/shared_memory/shared_memory.h>
 #include <rpos/system/shared_memory/shm_topic_manager.h>
 #include <rpos/core/pose.h>
 #include <ros/ros.h>
 #include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/MultiEchoLaserScan.h>
 #include <nav_msgs/Odometry.h>
 #include <geometry_msgs/Twist.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <sensor_msgs/JointState.h>
 #include <geometry_msgs/Vector3Stamped.h>
-#include <tf2/LinearMath/Transform.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/Range.h>
+#include <sensor_msgs/BatteryState.h>
+#include <std_msgs/Bool.h>
+#include <rosgraph_msgs/Clock.h>
+#include <std_srvs/Trigger.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <thread>
 
 namespace rp { namespace slamware { namespace utils {
 
@@ -29,8 +49,73 @@ namespace rp { namespace slamware { namespace utils {
 
     class Ros1Node : public Ros1NodeBase
     {
+        static const int MaxRangeSensors = 32;
+
+        struct RangeSample
+        {
+            float dist;
+            bool valid;
+            std::int64_t receivedTime;      // steady time in ms
+        };
+
+        // odometry as received, decoded into a transform only when fetched
+        struct RawOdometry
+        {
+            double position[3];
+            double orientation[4];      // x, y, z, w
+            std::uint64_t timestamp;    // steady time in us
+        };
+
+        // (vx, vy, omega), in the base frame
+        struct BaseVelocity
+        {
+            float v[3];
+        };
+
+        struct ActuationProbe
+        {
+            float command[3];
+            float baseline[3];
+            std::int64_t requestTime;       // steady time in us
+        };
+
+        struct FusedPose
+        {
+            double x;
+            double y;
+            double yaw;
+            std::uint64_t timestamp;    // steady time in us
+        };
+
+        struct ImuSample
+        {
+            float acc[3];
+            float gyro[3];
+            double gyroIntegral[3];     // unbounded, float would quantize the increments after a few hours
+        };
+
+        // appends the points kept by the scan converter to the shared memory scan
+        struct ShmPointWriter
+        {
+            explicit ShmPointWriter(rpos::system::shared_memory::LaserScan& scan)
+                : scan(scan)
+            {}
+
+            void operator()(float rad, float dist) const
+            {
+                rpos::system::shared_memory::LaserPoint p;
+                p.angle = rad;
+                p.dist = dist;
+                p.valid = true;
+                scan.data.push_back(p);
+            }
+
+            rpos::system::shared_memory::LaserScan& scan;
+        };
+
     public:
-        Ros1Node(int argc, char** argv, const std::string& nodeName);
+        // an offline node never contacts a ros master, it is driven through feed() with the default config
+        Ros1Node(int argc, char** argv, const std::string& nodeName, bool offline = false);
         ~Ros1Node();
 
     public:
@@ -41,8 +126,8 @@ namespace rp { namespace slamware { namespace utils {
         template <typename msgT>
         void advertise(std::string& msgTopic, std::uint32_t queueSize, MsgType msgType)
         {
-            if (msgType == MsgTypeVelocity)
-                pubVelocity_ = nh_.advertise<msgT>(msgTopic, queueSize);
+            if (msgType == MsgTypeVelocity && nh_)
+                pubVelocity_ = nh_->advertise<msgT>(msgTopic, queueSize);
         }
 
         template <typename msgT>
@@ -54,37 +139,136 @@ namespace rp { namespace slamware { namespace utils {
 
 	void clear();
 
+        // deliver a message straight to the callback of its type, as if it arrived on the subscribed topic
+        void feed(const sensor_msgs::LaserScan::ConstPtr& msg) { laserScanCallback_(msg); }
+        void feed(const sensor_msgs::MultiEchoLaserScan::ConstPtr& msg) { multiEchoScanCallback_(msg); }
+        void feed(const nav_msgs::Odometry::ConstPtr& msg) { odometryCallback_(msg); }
+        void feed(const geometry_msgs::Vector3Stamped::ConstPtr& msg) { deadReckonCallback_(msg); }
+        void feed(const sensor_msgs::Imu::ConstPtr& msg) { imuCallback_(msg); }
+
     public:
         bool getLaserScan(rpos::message::lidar::LidarScan& lidarData);
-        rpos::core::Vector3f getDeadReckon(uint64_t& timestamp);
+        rpos::core::Vector3f getDeadReckon(uint64_t& timestamp);      // timestamp in us of the steady clock
+        void getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData);
+        void getExtendedSensorData(std::vector<PseudoBaseDevice::BaseSensorData>& extendedSensorData);
+        void getBaseStatus(PseudoBaseDevice::BaseStatusData& data);
+        void onMotionRequest(const rpos::message::base::MotionRequest& request);
+        bool guardMotion(rpos::message::base::MotionRequest& request) const;
+        ros::Time rosTimeOf(std::int64_t steadyTimeUs) const;  // the current sim time under use_sim_time
+        void sleepFor(std::int64_t us);
+        LatencyHistogram::Summary takeActuationLatency(std::uint64_t& timeouts);
+        LatencyStat::Summary takeOdometryCallbackCost();    // in ns
+        // drift of the ros to steady clock offset since startup, and the number of steps since the previous call, in us
+        std::int64_t takeClockDrift(std::uint64_t& steps);
         void registerLidarDevice(boost::shared_ptr<PseudoRPLidarDevice> lidarDevice){ lidarDevice_ = lidarDevice; }
         void registerBaseDevice(boost::shared_ptr<PseudoBaseDevice> baseDevice){ baseDevice_ = baseDevice; }
+        // converted scans are recorded before they are handed to the lidar device, set before subscribing.
+        // With its flight recorder enabled, the dump_flight_recorder service is advertised
+        void setRecorder(SessionRecorder* recorder);
 
     private:
+        template <typename MsgT>
+        ros::Subscriber subscribe_(const std::string& topic, std::uint32_t queueSize, void (Ros1Node::*callback)(const boost::shared_ptr<const MsgT>&))
+        {
+            return nh_ ? nh_->subscribe(topic, queueSize, callback, this) : ros::Subscriber();
+        }
         void laserScanCallback_(const sensor_msgs::LaserScan::ConstPtr& msg);
+        void multiEchoScanCallback_(const sensor_msgs::MultiEchoLaserScan::ConstPtr& msg);
+        template <typename ScanMsgT, typename ConverterT>
+        void convertScan_(const ScanMsgT& msg, size_t beamCount, ConverterT convert);
         void odometryCallback_(const nav_msgs::Odometry::ConstPtr& msg);
         void deadReckonCallback_(const geometry_msgs::Vector3Stamped::ConstPtr& msg);
+        void imuCallback_(const sensor_msgs::Imu::ConstPtr& msg);
+        void rangeCallback_(const sensor_msgs::Range::ConstPtr& msg, int sensorId);
+        void batteryCallback_(const sensor_msgs::BatteryState::ConstPtr& msg);
+        void dockCallback_(const std_msgs::Bool::ConstPtr& msg);
+        void clockCallback_(const rosgraph_msgs::Clock::ConstPtr& msg);
+        bool dumpFlightRecorder_(std_srvs::Trigger::Request& request, std_srvs::Trigger::Response& response);
+        void fusionThread_();
+        void stopFusion_();
+        void checkActuation_(const float (&velocity)[3], std::int64_t receivedTime);
+        bool endActuationProbe_(std::uint32_t sequence);
         void generateTimeOffset_();
+        std::int64_t sampleTimeOffset_() const;
+        void clockThread_();
+        void stopClockSync_();
+        std::int64_t steadyTimeUsOf_(const ros::Time& stamp) const;
         bool ensureSharedMemoryTopic_();
     private:
-        ros::NodeHandle nh_;
+        std::unique_ptr<ros::NodeHandle> nh_;      // null when offline
         ros::Subscriber subLaserScan_;
         ros::Subscriber subOdometry_;
+        ros::Subscriber subImu_;
+        std::vector<ros::Subscriber> subRanges_;
+        ros::Subscriber subBattery_;
+        ros::Subscriber subDock_;
+        ros::Subscriber subClock_;
         ros::Publisher pubVelocity_;
+        ros::ServiceServer srvDumpFlightRecorder_;
 
-        ros::Time startupSystemTime_;
-        uint64_t startupSteadyTime_;
+        // ros time - steady time in ns, resampled and filtered by the clock thread
+        std::atomic<std::int64_t> timeOffset_;
+        std::int64_t startupTimeOffset_;
+        std::atomic<std::uint64_t> timeOffsetSteps_;
+        double clockSyncInterval_;
+        bool clockWorking_;
+        std::mutex clockLock_;
+        std::condition_variable clockSignal_;
+        std::thread clockWorker_;
+
+        // under use_sim_time the offset stays 0, the bridge time base is /clock itself
+        bool simTimeEnabled_;
+        std::atomic<std::int64_t> simClockUs_;
+        std::mutex simClockLock_;
+        std::condition_variable simClockSignal_;
 
         std::mutex laserDataLock_;
         rpos::message::lidar::LidarScan laserScan_;
 
         bool isOdometry_;
         std::mutex poseDataLock_;
-        uint64_t odomTimestamp_;
-        bool initEstimationFlag_;
-        tf2::Transform pose_;
-        tf2::Transform prePose_;
-        std::vector<rpos::core::Vector3f> deadreckon_;
+        uint64_t odomTimestamp_;        // steady time in us
+        LatestSlot<RawOdometry> rawOdometry_;
+        PoseDelta poseDelta_;
+        LatencyStat odometryCallbackCost_;
+        DeadReckonIncrements deadreckon_;
+        DeadReckonIncrements deadreckonFetched_;    // owned by the fetching thread
+        std::vector<float> deadreckonHeadings_;     // owned by the fetching thread
+
+        LatestSlot<RangeSample> rangeSamples_[MaxRangeSensors];
+        std::atomic<int> rangeSensorCount_;
+        std::int64_t rangeTimeout_;     // in ms
+
+        // battery and dock callbacks both run on the ros spin thread, which is the single writer
+        PseudoBaseDevice::BaseStatusData baseStatus_;
+        LatestSlot<PseudoBaseDevice::BaseStatusData> baseStatusSnapshot_;
+
+        LatestSlot<ImuSample> imuSample_;
+        ros::Time imuStamp_;            // owned by the ros callback thread
+        double gyroIntegral_[3];        // owned by the ros callback thread
+
+        // wheel odometry / gyro complementary fusion, stepped at the IMU rate on its own thread
+        bool imuFusionEnabled_;
+        double imuFusionTimeConstant_;
+        std::atomic<bool> fusionWorking_;
+        std::mutex fusionLock_;
+        std::condition_variable fusionSignal_;
+        std::thread fusionWorker_;
+        LatestSlot<FusedPose> fusedPose_;
+
+        ScanConverter scanConverter_;      // owned by the ros callback thread
+
+        // the interchip thread only writes the probe while it is inactive, the ros thread only reads it while it is active
+        std::atomic<bool> actuationProbeActive_;
+        LatestSlot<ActuationProbe> actuationProbe_;
+        LatestSlot<BaseVelocity> odomVelocity_;
+        LatencyHistogram actuationLatency_;
+        std::atomic<std::uint64_t> actuationTimeouts_;
+
+        bool reflexStopEnabled_;
+        ReflexGuard reflexGuard_;
+
+        SessionRecorder* recorder_;
 
         bool enable_shared_memory_;
         boost::shared_ptr<PseudoRPLidarDevice> lidarDevice_;
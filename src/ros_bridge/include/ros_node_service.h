@@ -1,10 +1,13 @@
 #pragma once
 
 #include "config.h"
+#include "latency_stat.h"
+#include "session_recorder.h"
 #include <rp/slamware/utils/pseudo_rplidar_device.h>
 #include <rp/slamware/utils/pseudo_base_device.h>
 #include <rpos/message/lidar_messages.h>
 #include <rpos/message/base_messages.h>
+#include <rpos/message/imu_messages.h>
 #include <rpos/core/pose.h>
 #include <rpos/context/base_service.h>
 #include <rpos/rpos.h>
@@ -13,6 +16,7 @@
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 
 namespace rp { namespace slamware { namespace utils {
 
@@ -24,9 +28,14 @@ namespace rp { namespace slamware { namespace utils {
         virtual bool getLaserScan(rpos::message::lidar::LidarScan& lidarData) = 0;
         virtual void publishMotion(const rpos::message::base::MotionRequest& request) = 0;
         virtual void getMovementEstimation(rpos::message::Message<rpos::message::base::MovementEstimation>& estimation) = 0;
+        virtual void getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData) = 0;
+        virtual void getExtendedSensorData(std::vector<PseudoBaseDevice::BaseSensorData>& extendedSensorData) = 0;
+        virtual void getBaseStatus(PseudoBaseDevice::BaseStatusData& data) = 0;
         virtual void registerLidarDevice(boost::shared_ptr<PseudoRPLidarDevice> lidarDevice) = 0;
         virtual void registerBaseDevice(boost::shared_ptr<PseudoBaseDevice> baeDevice) = 0;
         virtual const RosNodeConfig& config() = 0;
+        virtual void reportStats() = 0;
+        virtual void sleepFor(std::int64_t us) = 0;     // in the bridge time base, the simulated time under use_sim_time
     };
 
     template <typename RosHandlerT>
@@ -46,19 +55,42 @@ namespace rp { namespace slamware { namespace utils {
         virtual bool getLaserScan(rpos::message::lidar::LidarScan& lidarData);
         virtual void publishMotion(const rpos::message::base::MotionRequest& request);
         virtual void getMovementEstimation(rpos::message::Message<rpos::message::base::MovementEstimation>& estimation);
+        virtual void getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData);
+        virtual void getExtendedSensorData(std::vector<PseudoBaseDevice::BaseSensorData>& extendedSensorData);
+        virtual void getBaseStatus(PseudoBaseDevice::BaseStatusData& data);
         virtual void registerLidarDevice(boost::shared_ptr<PseudoRPLidarDevice> lidarDevice);
         virtual void registerBaseDevice(boost::shared_ptr<PseudoBaseDevice> baeDevice);
         virtual const RosNodeConfig& config() { return config_;}
+        virtual void reportStats();
+        virtual void sleepFor(std::int64_t us);
+
+    private:
+        void motionThread_();
+        void publishVelocity_(const rpos::message::base::MotionRequest& request, std::int64_t requestTime);
  
     private: 
         RosNodeConfig config_;
 
+        SessionRecorder recorder_;      // outlives the ros node, which records scans into it
         std::shared_ptr<RosHandlerT> rosNode_;
         bool initEstimationFlag_;
         float dXSinceLastFetch_;
         float dYSinceLastFetch_;
         float dYawSinceLastFetch_;
         std::mutex dOdomDataLock_;
+
+        // single slot, latest wins mailbox between the interchip request thread and the publisher thread
+        std::mutex motionLock_;
+        std::condition_variable motionSignal_;
+        bool motionWorking_;
+        bool motionPending_;
+        rpos::message::base::MotionRequest pendingMotion_;
+        std::int64_t pendingMotionTime_;    // steady time in us
+        std::thread motionPublisher_;
+
+        std::atomic<std::uint64_t> coalescedMotions_;
+        LatencyStat motionLatency_;
+        std::atomic<std::uint64_t> reflexStops_;
     };
 
 }}}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <rpos/message/lidar_messages.h>
+#include <rpos/system/encoding/rle_encoder.h>
+#include <rpos/system/encoding/rle_decoder.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Compact encoding of the converted scans, for the session recordings.
+    //
+    // Ranges are quantized to RangeResolution. Angles are replaced by their index on the beam grid
+    // (base + index * step) whenever every point lies within AngleTolerance of it, which holds for
+    // the scans out of ScanConverter, the points dropped as out of range only leave gaps in the index.
+    // A range is coded against the range of the same index in the previous scan, or against the
+    // previous point when there is none. The planes of index gaps, residuals, qualities and layers
+    // are then RLE compressed.
+    //
+    // Delta frames only decode after the frame before them, a keyframe is forced every
+    // keyframeInterval scans and whenever the grid changes, so a reader starting anywhere in a
+    // recording, or losing a frame, picks up at the next keyframe.
+    //
+    // frame: version (u8) | flags (u8) | sequence (u8) | point count | [base (f32) | step (f32)]
+    //        | [layer count | (length | layer)...] | body size | body, RLE compressed or not
+    // counts, sizes and lengths are varints
+    class ScanCodec
+    {
+    public:
+        static const float RangeResolution;     // m
+        static const float AngleTolerance;      // degree
+
+    protected:
+        enum Flags
+        {
+            FlagKeyframe = 1,
+            FlagGrid = 2,               // else the body ends with the raw angles
+            FlagLayers = 4,             // the body holds a layer index per point
+            FlagInvalid = 8,            // the body holds a valid flag per point
+            FlagRle = 16
+        };
+
+        static const std::uint8_t Version = 1;
+
+        ScanCodec();
+
+        // quantized range of the previous scan at the grid index, or previous when there is none
+        int predict_(bool temporal, int index, int previous) const;
+        // the scan just coded becomes the reference of the next one, indexes are empty without grid
+        void updateReference_(const std::vector<int>& indexes, const std::vector<int>& ranges);
+
+    protected:
+        bool hasReference_;
+        std::uint8_t sequence_;
+        float base_;
+        float step_;
+        std::vector<int> reference_;        // per grid index, -1 where the previous scan had no point
+        std::vector<int> nextReference_;
+    };
+
+    // not thread safe, an encoder belongs to the writer of a single stream
+    class ScanEncoder : public ScanCodec
+    {
+    public:
+        explicit ScanEncoder(int keyframeInterval = 20);
+
+        // the next scan is encoded as a keyframe
+        void reset();
+        void encode(const rpos::message::lidar::LidarScan& scan, std::vector<std::uint8_t>& frame);
+
+    private:
+        bool fitGrid_(const rpos::message::lidar::LidarScan& scan, float base, float step);
+        bool findGrid_(const rpos::message::lidar::LidarScan& scan);
+
+    private:
+        int keyframeInterval_;
+        int sinceKeyframe_;
+        std::vector<int> indexes_;
+        std::vector<int> ranges_;
+        std::vector<std::string> layers_;
+        std::vector<std::uint8_t> body_;
+        std::vector<std::uint8_t> compressed_;
+        rpos::system::encoding::RleEncoder rle_;
+    };
+
+    // not thread safe, a decoder belongs to the reader of a single stream
+    class ScanDecoder : public ScanCodec
+    {
+    public:
+        ScanDecoder();
+
+        void reset();
+        // false for a corrupted frame, or a delta frame not following the previous decoded one
+        bool decode(const std::uint8_t* frame, size_t size, rpos::message::lidar::LidarScan& scan);
+        bool decode(const std::vector<std::uint8_t>& frame, rpos::message::lidar::LidarScan& scan)
+        {
+            return decode(frame.data(), frame.size(), scan);
+        }
+
+    private:
+        std::vector<int> indexes_;
+        std::vector<int> ranges_;
+        std::vector<std::string> layers_;
+        std::vector<std::uint8_t> body_;
+        rpos::system::encoding::RleDecoder rle_;
+    };
+
+}}}
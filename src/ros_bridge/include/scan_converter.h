@@ -0,0 +1,194 @@
+#pragma once
+
+#include "reflex_guard.h"
+#include <rpos/core/angle_math.h>
+#include <rpos/message/lidar_messages.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace rp { namespace slamware { namespace utils {
+
+    enum EchoSelection
+    {
+        EchoSelectionFirst,
+        EchoSelectionLast,
+        EchoSelectionStrongest,
+        EchoSelectionNearest,
+        EchoSelectionAll        // every echo is forwarded, tagged by LidarScanPoint::layer ("echo0", "echo1", ...)
+    };
+
+    // Angular layout of a LaserScan once rotated by PI (RPlidar ROS SDK inverse all the data)
+    // and wrapped into [0, 2PI). The wrap index is computed once per scan, beams are then
+    // visited from it in rotated order so that the emitted angles are non-decreasing.
+    class ScanGeometry
+    {
+    public:
+        ScanGeometry(float angleMin, float angleIncrement, int count)
+            : startRad_(rpos::core::constraitRadZeroTo2Pi(double(angleMin) + M_PI))
+            , increment_(angleIncrement)
+            , count_(count)
+            , wrapIndex_(0)
+        {
+            if (count_ <= 0 || increment_ == 0.0)
+                return;
+
+            if (increment_ > 0)
+                wrapIndex_ = int(std::ceil((2 * M_PI - startRad_) / increment_));
+            else
+                wrapIndex_ = int(std::floor(startRad_ / -increment_)) + 1;
+            wrapIndex_ = std::min(std::max(wrapIndex_, 0), count_);
+        }
+
+        int count() const { return count_; }
+
+        // index of the n-th beam in increasing angle order
+        int beamAt(int n) const
+        {
+            if (increment_ >= 0)
+                return (n + wrapIndex_) % count_;
+            return ((wrapIndex_ - 1 - n) % count_ + count_) % count_;
+        }
+
+        // angle of the beam in radian, within [0, 2PI)
+        float radOf(int beam) const
+        {
+            double rad = startRad_ + increment_ * beam;
+            if (beam >= wrapIndex_)
+                rad += (increment_ > 0) ? -2 * M_PI : 2 * M_PI;
+            return float(std::min(std::max(rad, 0.0), 2 * M_PI - 1e-6));
+        }
+
+    private:
+        double startRad_;
+        double increment_;
+        int count_;
+        int wrapIndex_;
+    };
+
+    // layout fields of sensor_msgs::LaserScan / MultiEchoLaserScan, count is the number of beams to convert
+    struct ScanLayout
+    {
+        float angleMin;
+        float angleIncrement;
+        float rangeMin;
+        float rangeMax;
+        int count;
+    };
+
+    // Converts scans in the ROS layout into slamware scans in increasing angle order.
+    // It does not depend on ROS, the node and the benchmark run the same code.
+    // Not thread safe, a converter belongs to the thread receiving the scans.
+    class ScanConverter
+    {
+    public:
+        struct NoPointHandler
+        {
+            void operator()(float, float) const {}
+        };
+
+    public:
+        ScanConverter();
+
+        void setEchoSelection(EchoSelection echoSelection) { echoSelection_ = echoSelection; }
+        EchoSelection echoSelection() const { return echoSelection_; }
+        // fed with every point kept, nullptr to disable
+        void setReflexGuard(ReflexGuard* reflexGuard) { reflexGuard_ = reflexGuard; }
+
+        // ranges[beam], onPoint(rad, dist) is called for every point kept
+        template <typename PointHandlerT>
+        void convert(const ScanLayout& layout, const float* ranges, rpos::message::lidar::LidarScan& scan, PointHandlerT onPoint)
+        {
+            forEachBeam_(layout, scan, [&](int beam, float rad) {
+                pushPoint_(scan, layout, rad, ranges[beam], nullptr, onPoint);
+            });
+        }
+
+        void convert(const ScanLayout& layout, const float* ranges, rpos::message::lidar::LidarScan& scan)
+        {
+            convert(layout, ranges, scan, NoPointHandler());
+        }
+
+        // echoesOf(beam) returns the echoes of the beam as const std::vector<float>&,
+        // intensitiesOf(beam) the matching intensities or nullptr if there are none.
+        // With EchoSelectionAll, onPoint is only called for the first echo kept of each beam.
+        template <typename EchoesT, typename IntensitiesT, typename PointHandlerT>
+        void convertMultiEcho(const ScanLayout& layout, EchoesT echoesOf, IntensitiesT intensitiesOf, rpos::message::lidar::LidarScan& scan, PointHandlerT onPoint)
+        {
+            forEachBeam_(layout, scan, [&](int beam, float rad) {
+                const std::vector<float>& echoes = echoesOf(beam);
+                if (echoSelection_ == EchoSelectionAll)
+                {
+                    for (size_t e = echoLayers_.size(); e < echoes.size(); e++)
+                        echoLayers_.push_back("echo" + std::to_string(e));
+                    // the shm scan has no layer to tell the echoes apart, it gets the first one in range only
+                    NoPointHandler skip;
+                    bool forwarded = false;
+                    for (size_t e = 0; e < echoes.size(); e++)
+                    {
+                        if (forwarded)
+                            pushPoint_(scan, layout, rad, echoes[e], &echoLayers_[e], skip);
+                        else
+                            forwarded = pushPoint_(scan, layout, rad, echoes[e], &echoLayers_[e], onPoint);
+                    }
+                    return;
+                }
+
+                int e = selectEcho(echoes, intensitiesOf(beam), layout.rangeMin, layout.rangeMax);
+                if (e >= 0)
+                    pushPoint_(scan, layout, rad, echoes[e], nullptr, onPoint);
+            });
+        }
+
+        // index of the echo to keep, -1 if none is in range
+        int selectEcho(const std::vector<float>& echoes, const std::vector<float>* intensities, float rangeMin, float rangeMax) const;
+
+    private:
+        template <typename BeamHandlerT>
+        void forEachBeam_(const ScanLayout& layout, rpos::message::lidar::LidarScan& scan, BeamHandlerT handleBeam)
+        {
+            ScanGeometry geometry(layout.angleMin, layout.angleIncrement, layout.count);
+            scan.reserve(scan.size() + layout.count);
+            if (reflexGuard_)
+                reflexGuard_->beginScan();
+            for (int n = 0; n < geometry.count(); n++)
+            {
+                int beam = geometry.beamAt(n);
+                handleBeam(beam, geometry.radOf(beam));
+            }
+            if (reflexGuard_)
+                commitReflexScan_();
+        }
+
+        // false when the point is out of range and dropped
+        template <typename PointHandlerT>
+        bool pushPoint_(rpos::message::lidar::LidarScan& scan, const ScanLayout& layout, float rad, float dist, const std::string* layer, PointHandlerT& onPoint)
+        {
+            if (dist < layout.rangeMin || dist > layout.rangeMax)
+                return false;
+
+            rpos::message::lidar::LidarScanPoint lidarPoint;
+            lidarPoint.dist = dist;
+            lidarPoint.angle = rpos::core::rad2deg(rad);
+            lidarPoint.valid = true;
+            lidarPoint.quality = 0;
+            if (layer)
+                lidarPoint.layer = *layer;
+            scan.push_back(lidarPoint);
+            // the guard works on the laser angle, before the RPlidar rotation by PI
+            if (reflexGuard_)
+                reflexGuard_->addPoint(rad - float(M_PI), dist);
+            onPoint(rad, dist);
+            return true;
+        }
+
+        void commitReflexScan_();
+
+    private:
+        EchoSelection echoSelection_;
+        std::vector<std::string> echoLayers_;
+        ReflexGuard* reflexGuard_;
+    };
+
+}}}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Planar rigid transform (x, y, yaw), with the rotation cached as cos / sin
+    class Se2Pose
+    {
+    public:
+        Se2Pose()
+            : x_(0.0), y_(0.0), yaw_(0.0), cos_(1.0), sin_(0.0)
+        {}
+
+        Se2Pose(double x, double y, double yaw)
+            : x_(x), y_(y), yaw_(normalize_(yaw)), cos_(std::cos(yaw)), sin_(std::sin(yaw))
+        {}
+
+        // projection of a 3D pose onto the plane, only the yaw of the quaternion is kept
+        static Se2Pose fromQuaternion(double x, double y, double qx, double qy, double qz, double qw)
+        {
+            double sinYaw = 2.0 * (qw * qz + qx * qy);
+            double cosYaw = 1.0 - 2.0 * (qy * qy + qz * qz);
+            return Se2Pose(x, y, std::atan2(sinYaw, cosYaw));
+        }
+
+        double x() const { return x_; }
+        double y() const { return y_; }
+        double yaw() const { return yaw_; }
+
+        // this * rhs
+        Se2Pose operator*(const Se2Pose& rhs) const
+        {
+            return Se2Pose(x_ + cos_ * rhs.x_ - sin_ * rhs.y_, y_ + sin_ * rhs.x_ + cos_ * rhs.y_, yaw_ + rhs.yaw_,
+                cos_ * rhs.cos_ - sin_ * rhs.sin_, sin_ * rhs.cos_ + cos_ * rhs.sin_);
+        }
+
+        Se2Pose inverse() const
+        {
+            return Se2Pose(-cos_ * x_ - sin_ * y_, sin_ * x_ - cos_ * y_, -yaw_, cos_, -sin_);
+        }
+
+        // inverse() * rhs, the pose of rhs expressed in this frame
+        Se2Pose inverseTimes(const Se2Pose& rhs) const
+        {
+            double dx = rhs.x_ - x_;
+            double dy = rhs.y_ - y_;
+            return Se2Pose(cos_ * dx + sin_ * dy, -sin_ * dx + cos_ * dy, rhs.yaw_ - yaw_,
+                cos_ * rhs.cos_ + sin_ * rhs.sin_, cos_ * rhs.sin_ - sin_ * rhs.cos_);
+        }
+
+        // linear in translation, shortest arc in yaw, t within [0, 1]
+        static Se2Pose interpolate(const Se2Pose& from, const Se2Pose& to, double t)
+        {
+            double dyaw = normalize_(to.yaw_ - from.yaw_);
+            return Se2Pose(from.x_ + (to.x_ - from.x_) * t, from.y_ + (to.y_ - from.y_) * t, from.yaw_ + dyaw * t);
+        }
+
+        // Compose n increments, each expressed in the frame reached by the previous ones.
+        // The headings are prefix summed first, so the trigonometry and the accumulation run
+        // over independent iterations the compiler can vectorize. scratch is reused across calls.
+        static Se2Pose integrate(const float* dx, const float* dy, const float* dyaw, size_t n, std::vector<float>& scratch)
+        {
+            scratch.resize(n);
+            float heading = 0.f;
+            for (size_t i = 0; i < n; i++)
+            {
+                scratch[i] = heading;
+                heading += dyaw[i];
+            }
+
+            const float* headings = scratch.data();
+            float sumX = 0.f;
+            float sumY = 0.f;
+            for (size_t i = 0; i < n; i++)
+            {
+                float c = std::cos(headings[i]);
+                float s = std::sin(headings[i]);
+                sumX += dx[i] * c - dy[i] * s;
+                sumY += dx[i] * s + dy[i] * c;
+            }
+            return Se2Pose(sumX, sumY, heading);
+        }
+
+    private:
+        // yaw is the sum or difference of two normalized angles, cos / sin are already known
+        Se2Pose(double x, double y, double yaw, double c, double s)
+            : x_(x), y_(y), yaw_(yaw > M_PI ? yaw - 2 * M_PI : (yaw <= -M_PI ? yaw + 2 * M_PI : yaw)), cos_(c), sin_(s)
+        {}
+
+        static double normalize_(double yaw)
+        {
+            return std::atan2(std::sin(yaw), std::cos(yaw));
+        }
+
+    private:
+        double x_;
+        double y_;
+        double yaw_;
+        double cos_;
+        double sin_;
+    };
+
+}}}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "session_stream.h"
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Opens a recording made by SessionRecorder, from its oldest segment still on disk.
+    class SessionReader
+    {
+    public:
+        bool open(const std::string& directory);
+        void close();
+
+        // null until opened
+        SessionReadStream* messages() const { return messages_.get(); }
+
+    private:
+        boost::shared_ptr<rpos::system::io::IStream> stream_;
+        boost::shared_ptr<SessionReadStream> messages_;
+    };
+
+}}}
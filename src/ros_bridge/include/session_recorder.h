@@ -0,0 +1,129 @@
+#pragma once
+
+#include <rpos/message/message.h>
+#include <rpos/message/lidar_messages.h>
+#include <rpos/message/base_messages.h>
+#include <rpos/system/io/segmented_loop_files_write_stream.h>
+#include <rpos/system/util/log.h>
+#include "async_segmented_write_stream.h"
+#include "flight_recorder.h"
+#include "scan_codec.h"
+#include "session_stream.h"
+#include <boost/lockfree/queue.hpp>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Records what the bridge hands to the pseudo devices (converted scans, movement estimations
+    // and motion requests) through the SDK message write stream interface, so a field session can
+    // be replayed.
+    //
+    // The hot paths only copy into a preallocated record and push it on a lock-free queue, the
+    // serialization runs on the writer thread and the file writes behind it on the io thread of an
+    // AsyncSegmentedWriteStream. Records are dropped, and counted, when the writer falls behind by
+    // more than the queue size.
+    //
+    // Every recording is a directory named after its start time, holding the messages in segmented
+    // loop files (see SessionWriteStream for the framing). All timestamps are steady time in us.
+    // With compactScans, the scans are written with ScanEncoder under CompactScanTopic instead.
+    //
+    // The writer thread also feeds the flight recorder, which can run without the full recording.
+    class SessionRecorder
+    {
+    public:
+        struct Options
+        {
+            std::string path;               // parent directory of the recordings, empty for the flight recorder only
+            std::uint64_t segmentSize;      // in bytes
+            std::uint64_t spaceLimit;       // in bytes, the oldest segments are removed past this
+            size_t queueSize;               // records in flight between the hot paths and the writer
+            bool compactScans;
+            AsyncSegmentedWriteStream::Options io;
+            FlightRecorder::Options flight;
+        };
+
+        static const char* const ScanTopic;
+        static const char* const CompactScanTopic;     // payload: ScanEncoder frame
+        static const char* const MovementEstimationTopic;
+        static const char* const MotionRequestTopic;
+        static const char* const SegmentExtension;
+
+    public:
+        SessionRecorder();
+        ~SessionRecorder();
+
+        bool start(const Options& options);
+        // writes out the records still queued
+        void stop();
+        bool isRecording() const { return working_.load(std::memory_order_relaxed); }
+        const std::string& directory() const { return directory_; }   // empty without the full recording
+        bool isFlightRecording() const { return flightRecorder_.isEnabled(); }
+        // false without the flight recorder, the dump is written in the background
+        bool requestDump(const std::string& reason);
+
+        // called from the hot paths, never block
+        void recordScan(const rpos::message::lidar::LidarScan& scan, std::int64_t timestamp);
+        void recordMovementEstimation(const rpos::message::base::MovementEstimation& estimation, std::int64_t timestamp);
+        void recordMotionRequest(const rpos::message::base::MotionRequest& request, std::int64_t timestamp);
+
+        // counts since the previous call
+        std::uint64_t takeWritten() { return written_.exchange(0, std::memory_order_relaxed); }
+        std::uint64_t takeDropped() { return dropped_.exchange(0, std::memory_order_relaxed); }
+        // null without the full recording, kept until the next start for its stats
+        AsyncSegmentedWriteStream* io() const { return ioStream_.get(); }
+
+    private:
+        enum RecordType
+        {
+            RecordTypeScan,
+            RecordTypeMovementEstimation,
+            RecordTypeMotionRequest
+        };
+
+        // reused through the free list, so the scan keeps its capacity and steady state recording does not allocate
+        struct Record
+        {
+            RecordType type;
+            rpos::message::Message<rpos::message::lidar::LidarScan> scan;
+            rpos::message::Message<rpos::message::base::MovementEstimation> estimation;
+            rpos::message::Message<rpos::message::base::MotionRequest> motion;
+        };
+
+        typedef boost::lockfree::queue<Record*, boost::lockfree::fixed_sized<true> > RecordQueue;
+
+        bool openSegments_(const Options& options);
+        Record* acquire_();
+        void commit_(Record* record);
+        void writerThread_();
+        void write_(const Record& record);
+        template <typename PayloadT>
+        void write_(const char* topic, const rpos::message::Message<PayloadT>& message);
+        void releaseRecords_();
+
+    private:
+        static rpos::system::util::LogScope logger;
+
+        std::atomic<bool> working_;
+        std::string directory_;
+        std::unique_ptr<RecordQueue> freeRecords_;
+        std::unique_ptr<RecordQueue> pendingRecords_;
+        std::atomic<std::uint64_t> written_;
+        std::atomic<std::uint64_t> dropped_;
+
+        // owned by the writer thread while recording
+        boost::shared_ptr<rpos::system::io::SegmentedLoopFilesWriteStream> messageStream_;
+        boost::shared_ptr<AsyncSegmentedWriteStream> ioStream_;
+        boost::shared_ptr<SessionWriteStream> writer_;
+        bool compactScans_;
+        ScanEncoder scanEncoder_;
+        rpos::message::Message<std::vector<std::uint8_t> > compactScan_;
+        FlightRecorder flightRecorder_;
+        std::thread writerWorker_;
+    };
+
+}}}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <rpos/message/message.h>
+#include <rpos/system/diagnosis/i_message_write_stream.h>
+#include <rpos/system/io/i_stream.h>
+#include <rpos/system/io/memory_read_stream.h>
+#include <boost/shared_ptr.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rp { namespace slamware { namespace utils {
+
+    // Message framing of the session recordings. The payloads are the SDK diagnosis serialization of
+    // Message<T>, every frame carries its topic and a sync word, so a segment can be read on its own
+    // and a reader resyncs past a frame cut by a removed segment.
+    //
+    // frame: magic (u32) | topic length (u16) | body length (u32) | topic | body
+    class SessionWriteStream : public rpos::system::diagnosis::IMessageWriteStream
+    {
+    public:
+        static const std::uint32_t FrameMagic = 0x52425253;     // "SRBR"
+
+    public:
+        explicit SessionWriteStream(boost::shared_ptr<rpos::system::io::IStream> stream);
+        virtual ~SessionWriteStream();
+
+        std::uint64_t bytesWritten() const { return bytesWritten_; }
+
+    protected:
+        virtual void writeMessage(const std::string& topic, const std::type_index& typeIndex, const rpos::system::io::MemoryWriteStream& body, rpos::system::diagnosis::MessageWriteFlags flags);
+
+    private:
+        boost::shared_ptr<rpos::system::io::IStream> stream_;
+        std::vector<std::uint8_t> frame_;
+        std::uint64_t bytesWritten_;
+    };
+
+    class SessionReadStream
+    {
+    public:
+        explicit SessionReadStream(boost::shared_ptr<rpos::system::io::IStream> stream);
+
+        // reads the next frame header, false at the end of the stream
+        bool hasNextMessage();
+        const std::string& nextMessageTopic() const { return topic_; }
+        rpos::message::message_timestamp_t nextMessageTimestamp() const { return timestamp_; }
+
+        template <typename PayloadT>
+        bool read(rpos::message::Message<PayloadT>& message)
+        {
+            if (!pending_)
+                return false;
+            pending_ = false;
+            rpos::system::io::MemoryReadStream body(body_.data(), body_.size(), rpos::system::io::MemoryReadStream::MemoryReadStreamFlagBorrowBuffer);
+            rpos::system::diagnosis::serialization::read(body, message);
+            return true;
+        }
+        void skip() { pending_ = false; }
+
+        // bytes skipped to find the next frame, after a cut or corrupted one
+        std::uint64_t skippedBytes() const { return skippedBytes_; }
+
+    private:
+        bool fill_(size_t size);
+
+    private:
+        boost::shared_ptr<rpos::system::io::IStream> stream_;
+        std::vector<std::uint8_t> buffer_;
+        size_t begin_;
+        size_t end_;
+        bool pending_;
+        std::string topic_;
+        rpos::message::message_timestamp_t timestamp_;
+        std::vector<std::uint8_t> body_;
+        std::uint64_t skippedBytes_;
+    };
+
+}}}
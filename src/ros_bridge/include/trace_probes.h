@@ -0,0 +1,19 @@
+#pragma once
+
+// Static tracepoints on the bridge hot paths, USDT probes of the provider slamware_ros_bridge.
+//
+// A probe compiles to a single nop plus an ELF note, a tracer (bpftrace, perf, systemtap) patches
+// it only while attached, so the probes stay in release builds. Arguments are values already at
+// hand, they are not evaluated when sys/sdt.h is missing and the probes compile out. The scripts
+// under scripts/trace turn them into per-stage latencies.
+#if defined(SLAMWARE_ROS_BRIDGE_USDT)
+#include <sys/sdt.h>
+
+#define BRIDGE_TRACE(name) DTRACE_PROBE(slamware_ros_bridge, name)
+#define BRIDGE_TRACE1(name, a) DTRACE_PROBE1(slamware_ros_bridge, name, a)
+#define BRIDGE_TRACE2(name, a, b) DTRACE_PROBE2(slamware_ros_bridge, name, a, b)
+#else
+#define BRIDGE_TRACE(name) do {} while (0)
+#define BRIDGE_TRACE1(name, a) do {} while (0)
+#define BRIDGE_TRACE2(name, a, b) do {} while (0)
+#endif
@@ -0,0 +1,107 @@
+#!/bin/sh
+# Per-stage latency histograms of a running bridge from its USDT probes, printed on ctrl-c.
+#
+#   sudo ./bridge_stages.sh <pid> [binary]
+#
+# The binary defaults to the executable of the process, pass it when that path is not readable.
+# Needs bpftrace and a bridge built with sys/sdt.h available.
+
+set -e
+
+if [ -z "$1" ]; then
+    echo "usage: $0 <pid> [binary]" >&2
+    exit 1
+fi
+PID=$1
+BIN=${2:-$(readlink -f /proc/$PID/exe)}
+P="usdt:$BIN:slamware_ros_bridge"
+
+exec bpftrace -p "$PID" -e "
+$P:scan_begin
+{
+    @scan_start[tid] = nsecs;
+    @stage_start[tid] = nsecs;
+}
+
+$P:scan_converted
+/@stage_start[tid]/
+{
+    @convert_us = hist((nsecs - @stage_start[tid]) / 1000);
+    @points = stats(arg1);
+    @stage_start[tid] = nsecs;
+}
+
+// recording and the pseudo lidar device, up to the slamware client
+$P:scan_delivered
+/@stage_start[tid]/
+{
+    @deliver_us = hist((nsecs - @stage_start[tid]) / 1000);
+    @stage_start[tid] = nsecs;
+}
+
+$P:shm_published
+/@stage_start[tid]/
+{
+    @shm_publish_us = hist((nsecs - @stage_start[tid]) / 1000);
+    @stage_start[tid] = nsecs;
+}
+
+$P:scan_end
+/@scan_start[tid]/
+{
+    @scan_callback_us = hist((nsecs - @scan_start[tid]) / 1000);
+    delete(@scan_start[tid]);
+    delete(@stage_start[tid]);
+}
+
+$P:dead_reckon_begin
+{
+    @dead_reckon_start[tid] = nsecs;
+}
+
+$P:dead_reckon_end
+/@dead_reckon_start[tid]/
+{
+    @dead_reckon_us = hist((nsecs - @dead_reckon_start[tid]) / 1000);
+    delete(@dead_reckon_start[tid]);
+}
+
+// keyed by the request time, a coalesced request is never published and stays in the map
+$P:motion_request
+{
+    @motion_start[arg0] = nsecs;
+}
+
+$P:motion_published
+/@motion_start[arg0]/
+{
+    @motion_us = hist((nsecs - @motion_start[arg0]) / 1000);
+    delete(@motion_start[arg0]);
+}
+
+$P:heartbeat_begin
+{
+    if (@last_heartbeat) {
+        @heartbeat_interval_ms = hist((nsecs - @last_heartbeat) / 1000000);
+    }
+    @last_heartbeat = nsecs;
+    @heartbeat_start[tid] = nsecs;
+}
+
+$P:heartbeat_end
+/@heartbeat_start[tid]/
+{
+    @heartbeat_us = hist((nsecs - @heartbeat_start[tid]) / 1000);
+    delete(@heartbeat_start[tid]);
+}
+
+END
+{
+    clear(@scan_start);
+    clear(@stage_start);
+    clear(@dead_reckon_start);
+    clear(@motion_start);
+    clear(@heartbeat_start);
+    clear(@last_heartbeat);
+}
+"
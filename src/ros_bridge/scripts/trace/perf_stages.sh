@@ -0,0 +1,69 @@
+#!/bin/sh
+# Records the USDT probes of a running bridge with perf and summarizes the per-stage latencies.
+# The perf.data is kept, so the probes can be lined up with sched and block events recorded
+# along with them, e.g. EXTRA_EVENTS="-e sched:sched_switch".
+#
+#   sudo ./perf_stages.sh <pid> [seconds] [binary]
+
+set -e
+
+if [ -z "$1" ]; then
+    echo "usage: $0 <pid> [seconds] [binary]" >&2
+    exit 1
+fi
+PID=$1
+DURATION=${2:-10}
+BIN=${3:-$(readlink -f /proc/$PID/exe)}
+GROUP=sdt_slamware_ros_bridge
+
+perf buildid-cache --add "$BIN"
+for probe in scan_begin scan_converted scan_delivered shm_published scan_end \
+        dead_reckon_begin dead_reckon_end motion_request motion_published \
+        heartbeat_begin heartbeat_end; do
+    perf probe -q -x "$BIN" -a "$GROUP:$probe" 2>/dev/null || true
+done
+trap 'perf probe -q -d "$GROUP:*" 2>/dev/null || true' EXIT
+
+perf record -q -o perf.data -p "$PID" -e "$GROUP:*" $EXTRA_EVENTS -- sleep "$DURATION"
+
+# stage latency = time since the previous probe of the stage on the same thread
+perf script -i perf.data -F tid,time,event,trace 2>/dev/null | awk '
+function arg1(    i) {
+    for (i = 4; i <= NF; i++)
+        if ($i ~ /^arg1=/)
+            return substr($i, 6)
+    return ""
+}
+function stage(name, start) {
+    if (start == "")
+        return
+    v = ($2 - start) * 1e6
+    count[name]++
+    sum[name] += v
+    if (v > max[name])
+        max[name] = v
+}
+{
+    tid = $1
+    sub(/:$/, "", $2)
+    event = $3
+    sub(/:$/, "", event)
+    sub(/^.*:/, "", event)
+}
+event == "scan_begin"        { scan[tid] = $2; last[tid] = $2 }
+event == "scan_converted"    { stage("convert", last[tid]); last[tid] = $2 }
+event == "scan_delivered"    { stage("deliver", last[tid]); last[tid] = $2 }
+event == "shm_published"     { stage("shm_publish", last[tid]); last[tid] = $2 }
+event == "scan_end"          { stage("scan_callback", scan[tid]); delete scan[tid]; delete last[tid] }
+event == "dead_reckon_begin" { reckon[tid] = $2 }
+event == "dead_reckon_end"   { stage("dead_reckon", reckon[tid]); delete reckon[tid] }
+# keyed by the request time, a coalesced request is never published
+event == "motion_request"    { motion[arg1()] = $2 }
+event == "motion_published"  { key = arg1(); stage("motion", motion[key]); delete motion[key] }
+event == "heartbeat_begin"   { stage("heartbeat_interval", beat); beat = $2; heart[tid] = $2 }
+event == "heartbeat_end"     { stage("heartbeat", heart[tid]); delete heart[tid] }
+END {
+    printf "%-20s %10s %12s %12s\n", "stage", "count", "avg us", "max us"
+    for (name in count)
+        printf "%-20s %10d %12.1f %12.1f\n", name, count[name], sum[name] / count[name], max[name]
+}'
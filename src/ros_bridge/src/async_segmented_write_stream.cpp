@@ -0,0 +1,214 @@
+#include "async_segmented_write_stream.h"
+#include <rpos/system/util/time_util.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+
+namespace {
+
+    // segment writes go through stdio, keep the buffers page sized
+    const size_t kPageSize = 4096;
+
+    std::int64_t nowUs()
+    {
+        return rpos::system::util::high_resolution_clock::get_time_in_us();
+    }
+
+}
+
+namespace rp { namespace slamware { namespace utils {
+
+    AsyncSegmentedWriteStream::AsyncSegmentedWriteStream(boost::shared_ptr<rpos::system::io::SegmentedLoopFilesWriteStream> target, const Options& options)
+        : target_(target)
+        , options_(options)
+        , active_(nullptr)
+        , working_(true)
+        , accepted_(0)
+        , writtenBytes_(0)
+        , flushes_(0)
+    {
+        options_.bufferSize = std::max<size_t>((options.bufferSize + kPageSize - 1) / kPageSize, 1) * kPageSize;
+        // one filling while another one is written
+        options_.bufferCount = std::max<size_t>(options.bufferCount, 2);
+        options_.flushInterval = std::max<std::int64_t>(options.flushInterval, 1000);
+        for (size_t i = 0; i < options_.bufferCount; i++)
+        {
+            buffers_.emplace_back(new Buffer());
+            buffers_.back()->data.resize(options_.bufferSize);
+            buffers_.back()->size = 0;
+            freeBuffers_.push_back(buffers_.back().get());
+        }
+        ioWorker_ = std::thread(std::bind(&AsyncSegmentedWriteStream::ioThread_, this));
+    }
+
+    AsyncSegmentedWriteStream::~AsyncSegmentedWriteStream()
+    {
+        close();
+    }
+
+    bool AsyncSegmentedWriteStream::isOpen()
+    {
+        std::lock_guard<std::mutex> lkGuard(lock_);
+        return working_;
+    }
+
+    bool AsyncSegmentedWriteStream::canRead()
+    {
+        return false;
+    }
+
+    bool AsyncSegmentedWriteStream::canWrite()
+    {
+        return isOpen();
+    }
+
+    bool AsyncSegmentedWriteStream::canSeek()
+    {
+        return false;
+    }
+
+    void AsyncSegmentedWriteStream::close()
+    {
+        {
+            std::lock_guard<std::mutex> lkGuard(lock_);
+            if (!working_)
+                return;
+            submitActive_();
+            working_ = false;
+        }
+        ioSignal_.notify_one();
+        freeSignal_.notify_all();
+        if (ioWorker_.joinable())
+            ioWorker_.join();
+    }
+
+    bool AsyncSegmentedWriteStream::endOfStream()
+    {
+        return true;
+    }
+
+    int AsyncSegmentedWriteStream::read(void*, size_t)
+    {
+        return -1;
+    }
+
+    int AsyncSegmentedWriteStream::write(const void* buffer, size_t size)
+    {
+        std::unique_lock<std::mutex> lk(lock_);
+        if (!working_)
+            return -1;
+
+        if (active_ && active_->size + size > active_->data.size())
+            submitActive_();
+        if (!active_)
+        {
+            if (freeBuffers_.empty())
+            {
+                const std::int64_t stallStart = nowUs();
+                freeSignal_.wait(lk, [this] { return !freeBuffers_.empty() || !working_; });
+                stalls_.push(nowUs() - stallStart);
+                if (!working_)
+                    return -1;
+            }
+            active_ = freeBuffers_.front();
+            freeBuffers_.pop_front();
+        }
+
+        // a write larger than a buffer grows it, the buffer keeps the capacity
+        if (size > active_->data.size())
+            active_->data.resize(size);
+        std::memcpy(active_->data.data() + active_->size, buffer, size);
+        active_->size += size;
+        accepted_ += size;
+        if (active_->size == active_->data.size())
+            submitActive_();
+        return int(size);
+    }
+
+    size_t AsyncSegmentedWriteStream::tell()
+    {
+        std::lock_guard<std::mutex> lkGuard(lock_);
+        return accepted_;
+    }
+
+    void AsyncSegmentedWriteStream::seek(rpos::system::io::SeekType, int)
+    {
+    }
+
+    void AsyncSegmentedWriteStream::submitActive_()
+    {
+        if (!active_)
+            return;
+        if (active_->size)
+        {
+            fullBuffers_.push_back(active_);
+            ioSignal_.notify_one();
+        }
+        else
+        {
+            freeBuffers_.push_back(active_);
+        }
+        active_ = nullptr;
+    }
+
+    void AsyncSegmentedWriteStream::ioThread_()
+    {
+        std::int64_t nextFlush = nowUs() + options_.flushInterval;
+        bool dirty = false;
+        std::unique_lock<std::mutex> lk(lock_);
+        while (true)
+        {
+            if (fullBuffers_.empty() && working_)
+                ioSignal_.wait_for(lk, std::chrono::microseconds(std::max<std::int64_t>(nextFlush - nowUs(), 0)));
+
+            // a partially filled buffer is written once the flush interval elapsed
+            const std::int64_t now = nowUs();
+            if (fullBuffers_.empty() && now >= nextFlush)
+                submitActive_();
+
+            if (fullBuffers_.empty())
+            {
+                if (!working_ || now >= nextFlush)
+                {
+                    lk.unlock();
+                    if (dirty)
+                    {
+                        target_->flush();
+                        flushes_.fetch_add(1, std::memory_order_relaxed);
+                        dirty = false;
+                    }
+                    lk.lock();
+                    nextFlush = now + options_.flushInterval;
+                    if (!working_ && fullBuffers_.empty())
+                        break;
+                }
+                continue;
+            }
+
+            Buffer* buffer = fullBuffers_.front();
+            fullBuffers_.pop_front();
+            lk.unlock();
+
+            const std::int64_t writeStart = nowUs();
+            target_->write(buffer->data.data(), buffer->size);
+            const std::int64_t writeEnd = nowUs();
+            writeCost_.push(writeEnd - writeStart);
+            writtenBytes_.fetch_add(buffer->size, std::memory_order_relaxed);
+            dirty = true;
+            if (writeEnd >= nextFlush)
+            {
+                target_->flush();
+                flushes_.fetch_add(1, std::memory_order_relaxed);
+                dirty = false;
+                nextFlush = writeEnd + options_.flushInterval;
+            }
+
+            lk.lock();
+            buffer->size = 0;
+            freeBuffers_.push_back(buffer);
+            freeSignal_.notify_one();
+        }
+    }
+
+}}}
@@ -0,0 +1,257 @@
+// Feeds scan, odometry and IMU messages from a bag straight into the bridge callbacks, without a
+// ros master, TCPROS or ros::spin(). A prefetch thread reads and deserializes the bag chunk by chunk
+// ahead of the feeding thread, through a bounded queue. The movement estimation is fetched every
+// 20 ms of bag time, as slamware would.
+//
+// With rate 0 (the default) the bag is fed as fast as possible and the sustained scan throughput
+// of the conversion pipeline is reported, otherwise messages are paced at rate times the bag time.
+//
+// usage: slamware_ros_bridge_bag_ingest <bag> [rate] [scan topic] [odometry topic] [imu topic]
+
+#include "ros1_node.h"
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <rpos/system/util/time_util.h>
+#include <boost/make_shared.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    using namespace rp::slamware::utils;
+
+    const size_t kPrefetchDepth = 256;
+    const std::int64_t kFetchIntervalUs = 20000;
+
+    std::int64_t nowUs()
+    {
+        return rpos::system::util::high_resolution_clock::get_time_in_us();
+    }
+
+    class OfflineLidarDevice : public PseudoRPLidarDevice
+    {
+    protected:
+        // callback mode, scans are pushed by Ros1Node
+        virtual bool getScanData(rpos::message::lidar::LidarScan&) { return false; }
+    };
+
+    struct BagMessage
+    {
+        std::int64_t time;      // bag time in us
+        sensor_msgs::LaserScan::ConstPtr scan;
+        sensor_msgs::MultiEchoLaserScan::ConstPtr multiEchoScan;
+        nav_msgs::Odometry::ConstPtr odometry;
+        geometry_msgs::Vector3Stamped::ConstPtr deadreckon;
+        sensor_msgs::Imu::ConstPtr imu;
+    };
+
+    // reads the bag on its own thread, at most kPrefetchDepth messages ahead of the consumer
+    class BagPrefetcher
+    {
+    public:
+        BagPrefetcher(rosbag::View& view)
+            : view_(view), done_(false), stopped_(false), stalls_(0)
+        {
+            worker_ = std::thread([this] { readThread_(); });
+        }
+
+        ~BagPrefetcher()
+        {
+            {
+                std::lock_guard<std::mutex> lkGuard(lock_);
+                stopped_ = true;
+            }
+            signal_.notify_all();
+            worker_.join();
+        }
+
+        bool pop(BagMessage& message)
+        {
+            std::unique_lock<std::mutex> lk(lock_);
+            if (queue_.empty() && !done_)
+                stalls_++;
+            signal_.wait(lk, [this] { return !queue_.empty() || done_; });
+            if (queue_.empty())
+                return false;
+            message = std::move(queue_.front());
+            queue_.pop_front();
+            lk.unlock();
+            signal_.notify_all();
+            return true;
+        }
+
+        // the consumer found the queue empty, reading the bag was the bottleneck
+        std::uint64_t stalls() const { return stalls_; }
+
+    private:
+        void readThread_()
+        {
+            for (const rosbag::MessageInstance& instance : view_)
+            {
+                BagMessage message;
+                message.time = std::int64_t(instance.getTime().toNSec() / 1000);
+                if (!(message.scan = instance.instantiate<sensor_msgs::LaserScan>())
+                    && !(message.multiEchoScan = instance.instantiate<sensor_msgs::MultiEchoLaserScan>())
+                    && !(message.odometry = instance.instantiate<nav_msgs::Odometry>())
+                    && !(message.deadreckon = instance.instantiate<geometry_msgs::Vector3Stamped>())
+                    && !(message.imu = instance.instantiate<sensor_msgs::Imu>()))
+                    continue;
+
+                std::unique_lock<std::mutex> lk(lock_);
+                signal_.wait(lk, [this] { return queue_.size() < kPrefetchDepth || stopped_; });
+                if (stopped_)
+                    break;
+                queue_.push_back(std::move(message));
+                lk.unlock();
+                signal_.notify_all();
+            }
+            {
+                std::lock_guard<std::mutex> lkGuard(lock_);
+                done_ = true;
+            }
+            signal_.notify_all();
+        }
+
+    private:
+        rosbag::View& view_;
+        std::mutex lock_;
+        std::condition_variable signal_;
+        std::deque<BagMessage> queue_;
+        bool done_;
+        bool stopped_;
+        std::uint64_t stalls_;
+        std::thread worker_;
+    };
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <bag> [rate] [scan topic] [odometry topic] [imu topic]\n", argv[0]);
+        return 1;
+    }
+    const std::string bagPath = argv[1];
+    const double rate = argc > 2 ? std::atof(argv[2]) : 0.0;
+
+    Ros1Node rosNode(argc, argv, "slamware_ros_bridge_bag_ingest", true);
+    RosNodeConfig config;
+    rosNode.initConfig(config);
+    if (argc > 3)
+        config.scan_sub_topic = argv[3];
+    if (argc > 4)
+        config.odometry_sub_topic = argv[4];
+    if (argc > 5)
+        config.imu_sub_topic = argv[5];
+
+    rosbag::Bag bag;
+    try
+    {
+        bag.open(bagPath, rosbag::bagmode::Read);
+    }
+    catch (const rosbag::BagException& e)
+    {
+        std::fprintf(stderr, "can not open %s: %s\n", bagPath.c_str(), e.what());
+        return 1;
+    }
+
+    std::vector<std::string> topics;
+    topics.push_back(config.scan_sub_topic);
+    topics.push_back(config.odometry_sub_topic);
+    if (!config.imu_sub_topic.empty())
+        topics.push_back(config.imu_sub_topic);
+    rosbag::View view(bag, rosbag::TopicQuery(topics));
+
+    // the callbacks are selected from the recorded message types, as the launch file would
+    boost::shared_ptr<OfflineLidarDevice> lidarDevice = boost::make_shared<OfflineLidarDevice>();
+    rosNode.registerLidarDevice(lidarDevice);
+    for (const rosbag::ConnectionInfo* connection : view.getConnections())
+    {
+        if (connection->datatype == "sensor_msgs/LaserScan")
+            rosNode.subscribe(config.scan_sub_topic, 1, MsgTypeScan);
+        else if (connection->datatype == "sensor_msgs/MultiEchoLaserScan")
+            rosNode.subscribe(config.scan_sub_topic, 1, MsgTypeMultiEchoScan);
+        else if (connection->datatype == "nav_msgs/Odometry")
+            rosNode.subscribe(config.odometry_sub_topic, 10, MsgTypeOdometry);
+        else if (connection->datatype == "geometry_msgs/Vector3Stamped")
+            rosNode.subscribe(config.odometry_sub_topic, 10, MsgTypeDeadreckon);
+        else if (connection->datatype == "sensor_msgs/Imu")
+            rosNode.subscribe(config.imu_sub_topic, 50, MsgTypeImu);
+    }
+
+    LatencyStat scanCost;
+    std::uint64_t messages = 0;
+    std::uint64_t fetches = 0;
+    std::int64_t firstTime = -1;
+    std::int64_t lastTime = 0;
+    std::int64_t nextFetch = 0;
+    const std::int64_t start = nowUs();
+    std::uint64_t stalls = 0;
+    {
+        BagPrefetcher prefetcher(view);
+        BagMessage message;
+        while (prefetcher.pop(message))
+        {
+            if (firstTime < 0)
+            {
+                firstTime = message.time;
+                nextFetch = message.time + kFetchIntervalUs;
+            }
+            lastTime = message.time;
+            if (rate > 0)
+            {
+                std::int64_t due = start + std::int64_t((message.time - firstTime) / rate);
+                std::int64_t now = nowUs();
+                if (due > now)
+                    std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+            }
+
+            if (message.scan || message.multiEchoScan)
+            {
+                std::int64_t convertStart = rpos::system::util::high_resolution_clock::get_time_in_ns();
+                if (message.scan)
+                    rosNode.feed(message.scan);
+                else
+                    rosNode.feed(message.multiEchoScan);
+                scanCost.push(rpos::system::util::high_resolution_clock::get_time_in_ns() - convertStart);
+            }
+            else if (message.odometry)
+                rosNode.feed(message.odometry);
+            else if (message.deadreckon)
+                rosNode.feed(message.deadreckon);
+            else if (message.imu)
+                rosNode.feed(message.imu);
+            messages++;
+
+            while (message.time >= nextFetch)
+            {
+                std::uint64_t timestamp;
+                rosNode.getDeadReckon(timestamp);
+                fetches++;
+                nextFetch += kFetchIntervalUs;
+            }
+        }
+        stalls = prefetcher.stalls();
+    }
+    const double wallSeconds = (nowUs() - start) * 1e-6;
+    rosNode.clear();
+    bag.close();
+
+    LatencyStat::Summary scans = scanCost.takeSummary();
+    const double bagSeconds = firstTime < 0 ? 0.0 : (lastTime - firstTime) * 1e-6;
+    std::printf("%llu messages, %llu scans, %llu estimation fetches, %.1f s of bag in %.1f s (%.1fx)\n",
+        (unsigned long long)messages, (unsigned long long)scans.count, (unsigned long long)fetches,
+        bagSeconds, wallSeconds, wallSeconds > 0 ? bagSeconds / wallSeconds : 0.0);
+    std::printf("end to end %.1f scans/s, prefetch stalls %llu\n", wallSeconds > 0 ? scans.count / wallSeconds : 0.0, (unsigned long long)stalls);
+    std::printf("scan callback avg %.0f ns, max %lld ns, sustains %.0f scans/s\n", scans.average, (long long)scans.max,
+        scans.average > 0 ? 1e9 / scans.average : 0.0);
+    return 0;
+}
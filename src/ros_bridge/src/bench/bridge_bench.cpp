@@ -0,0 +1,690 @@
+// Benchmark of the ROS free conversion pipeline: synthetic scans and odometry are driven through
+// the core library, without a ros master, and reported as ns per scan, allocations per scan and
+// throughput for a matrix of beam counts. The compact scan encoding of the recordings is compared
+// with the SDK diagnosis serialization, in size and in encoding and decoding time, and the planar
+// pose math with the tf2 transforms it replaced. The reflex guard is checked against obstacles ahead
+// of and behind the robot, Se2Pose against tf2 over random poses, and the compact encoding against
+// the scans it round trips, the exit code is 1 on failure.
+//
+// usage: slamware_ros_bridge_bench [seconds per case]
+
+#include "odometry.h"
+#include "reflex_guard.h"
+#include "scan_codec.h"
+#include "scan_converter.h"
+#include <rpos/message/diagnosis/lidar_messages_serialization.h>
+#include <rpos/system/io/memory_read_stream.h>
+#include <rpos/system/io/memory_write_stream.h>
+#include <rpos/system/util/time_util.h>
+#include <tf2/LinearMath/Transform.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <random>
+#include <vector>
+
+namespace {
+
+    std::atomic<std::uint64_t> allocationCount(0);
+
+}
+
+void* operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+    using namespace rp::slamware::utils;
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Result
+    {
+        double nsPerOp;
+        double allocationsPerOp;
+        double opsPerSecond;
+    };
+
+    // runs op until the duration elapsed, after a short warm up
+    template <typename OpT>
+    Result measure(double seconds, OpT op)
+    {
+        for (int i = 0; i < 16; i++)
+            op();
+
+        const auto duration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        std::uint64_t ops = 0;
+        std::uint64_t allocationsBefore = allocationCount.load();
+        const auto start = Clock::now();
+        auto now = start;
+        do
+        {
+            for (int i = 0; i < 16; i++)
+                op();
+            ops += 16;
+            now = Clock::now();
+        } while (now - start < duration);
+
+        double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+        Result result;
+        result.nsPerOp = ns / ops;
+        result.allocationsPerOp = double(allocationCount.load() - allocationsBefore) / ops;
+        result.opsPerSecond = ops * 1e9 / ns;
+        return result;
+    }
+
+    // A rectangular room seen from off center, with range noise and a few dropouts.
+    // angle_min / angle_increment follow the usual 360 degree LaserScan layout.
+    struct SyntheticScan
+    {
+        ScanLayout layout;
+        std::vector<float> ranges;
+        std::vector<std::vector<float> > echoes;
+        std::vector<std::vector<float> > intensities;
+
+        // scans of the same beam count differ by their noise only, as from a robot standing still
+        SyntheticScan(int beamCount, int echoCount, unsigned seed = 0)
+        {
+            layout.angleMin = float(-M_PI);
+            layout.angleIncrement = float(2 * M_PI / beamCount);
+            layout.rangeMin = 0.15f;
+            layout.rangeMax = 25.f;
+            layout.count = beamCount;
+
+            std::mt19937 rng(beamCount + seed);
+            std::normal_distribution<float> noise(0.f, 0.01f);
+            std::uniform_real_distribution<float> uniform(0.f, 1.f);
+            const double robotX = -1.0;
+            const double halfX[2] = { 5.0, 3.0 };
+            const double halfY[2] = { 2.5, 1.5 };
+
+            ranges.resize(beamCount);
+            echoes.resize(beamCount);
+            intensities.resize(beamCount);
+            for (int i = 0; i < beamCount; i++)
+            {
+                double rad = layout.angleMin + layout.angleIncrement * i;
+                double c = std::fabs(std::cos(rad)) + 1e-9;
+                double s = std::fabs(std::sin(rad)) + 1e-9;
+                double toWallX = (std::cos(rad) > 0 ? halfX[0] - robotX : halfX[0] + robotX) / c;
+                float wall = float(std::min(toWallX, halfY[0] / s));
+                float range = uniform(rng) < 0.02f ? std::numeric_limits<float>::infinity() : wall + noise(rng);
+                ranges[i] = range;
+
+                // a closer partial return (glass, foliage) in front of the wall
+                for (int e = 0; e < echoCount; e++)
+                {
+                    float inner = float(std::min(halfX[1] / c, halfY[1] / s));
+                    echoes[i].push_back(e == 0 ? range : inner + noise(rng) + 0.5f * e);
+                    intensities[i].push_back(100.f * uniform(rng));
+                }
+            }
+        }
+    };
+
+    // An obstacle ahead in the base frame scales forward motion and not backward motion, and the
+    // other way around behind, for a laser mounted forward, sideways and backward.
+    bool checkReflexGuard()
+    {
+        const int beams = 720;
+        const float mounts[] = { 0.f, float(M_PI / 2), float(M_PI) };
+        bool ok = true;
+        for (float laserYaw : mounts)
+        {
+            for (int behind = 0; behind < 2; behind++)
+            {
+                ScanLayout layout;
+                layout.angleMin = float(-M_PI);
+                layout.angleIncrement = float(2 * M_PI / beams);
+                layout.rangeMin = 0.15f;
+                layout.rangeMax = 25.f;
+                layout.count = beams;
+
+                // a wall all around and a post 0.3 m away in the direction checked
+                const double obstacle = behind ? M_PI : 0.0;
+                std::vector<float> ranges(beams, 10.f);
+                for (int i = 0; i < beams; i++)
+                {
+                    double offset = layout.angleMin + layout.angleIncrement * i + laserYaw - obstacle;
+                    if (std::fabs(std::atan2(std::sin(offset), std::cos(offset))) < 0.2)
+                        ranges[i] = 0.3f;
+                }
+
+                ReflexGuard guard;
+                ReflexGuard::Config config;
+                config.robotRadius = 0.2f;
+                config.stopMargin = 0.05f;
+                config.deceleration = 1.0f;
+                config.reactionTime = 0.1f;
+                config.scanTimeout = 500000;
+                config.laserYaw = laserYaw;
+                guard.configure(config);
+                ScanConverter converter;
+                converter.setReflexGuard(&guard);
+                rpos::message::lidar::LidarScan scan;
+                converter.convert(layout, ranges.data(), scan);
+
+                const std::int64_t now = rpos::system::util::high_resolution_clock::get_time_in_us();
+                float forward = guard.speedScale(0.5f, 0.f, now);
+                float backward = guard.speedScale(-0.5f, 0.f, now);
+                bool pass = behind ? (forward >= 1.f && backward < 1.f) : (forward < 1.f && backward >= 1.f);
+                std::printf("reflex guard, laser yaw %5.2f, obstacle %-6s forward scale %.2f, backward scale %.2f: %s\n",
+                    laserYaw, behind ? "behind" : "ahead", forward, backward, pass ? "ok" : "FAILED");
+                ok = ok && pass;
+            }
+        }
+        std::printf("\n");
+        return ok;
+    }
+
+    // the tf2 transform getDeadReckon built before Se2Pose, for a planar pose
+    tf2::Transform toTf(const Se2Pose& pose)
+    {
+        tf2::Quaternion rotation;
+        rotation.setRPY(0.0, 0.0, pose.yaw());
+        return tf2::Transform(rotation, tf2::Vector3(pose.x(), pose.y(), 0.0));
+    }
+
+    double yawOf(const tf2::Transform& transform)
+    {
+        double roll, pitch, yaw;
+        transform.getBasis().getRPY(roll, pitch, yaw);
+        return yaw;
+    }
+
+    // largest of the x, y and yaw differences, in meter and radian
+    double poseError(const Se2Pose& pose, const tf2::Transform& transform)
+    {
+        double dyaw = pose.yaw() - yawOf(transform);
+        return std::max(std::max(std::fabs(pose.x() - transform.getOrigin().x()), std::fabs(pose.y() - transform.getOrigin().y())),
+            std::fabs(std::atan2(std::sin(dyaw), std::cos(dyaw))));
+    }
+
+    // Se2Pose::interpolate against linear translation and the shortest yaw arc, the arc unwrapped
+    // by whole turns rather than through atan2 as interpolate does
+    double interpolationError(const Se2Pose& from, const Se2Pose& to, double t)
+    {
+        double arc = to.yaw() - from.yaw();
+        while (arc > M_PI)
+            arc -= 2 * M_PI;
+        while (arc <= -M_PI)
+            arc += 2 * M_PI;
+        Se2Pose pose = Se2Pose::interpolate(from, to, t);
+        double dyaw = pose.yaw() - (from.yaw() + arc * t);
+        return std::max(std::max(std::fabs(pose.x() - (from.x() + (to.x() - from.x()) * t)), std::fabs(pose.y() - (from.y() + (to.y() - from.y()) * t))),
+            std::fabs(std::atan2(std::sin(dyaw), std::cos(dyaw))));
+    }
+
+    // Se2Pose against tf2 over random planar poses, and interpolate against its definition, across
+    // the +-PI wrap too. The batch integration sums in float, it is held to a float tolerance against
+    // the increments composed one by one in double.
+    bool checkSe2Pose()
+    {
+        const int kCases = 10000;
+        const int kIncrements = 100;
+        const double kTolerance = 1e-9;
+        const double kFloatTolerance = 1e-4;
+
+        std::mt19937 rng(2);
+        std::uniform_real_distribution<double> position(-50.0, 50.0);
+        std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+        std::uniform_real_distribution<float> step(-0.02f, 0.02f);
+        std::uniform_real_distribution<double> fraction(0.0, 1.0);
+
+        double composeError = 0.0;
+        double inverseError = 0.0;
+        double inverseTimesError = 0.0;
+        double quaternionError = 0.0;
+        double integrateError = 0.0;
+        double interpolateError = 0.0;
+        DeadReckonIncrements increments;
+        std::vector<float> scratch;
+        for (int i = 0; i < kCases; i++)
+        {
+            Se2Pose a(position(rng), position(rng), angle(rng));
+            Se2Pose b(position(rng), position(rng), angle(rng));
+            tf2::Transform ta = toTf(a);
+            tf2::Transform tb = toTf(b);
+            composeError = std::max(composeError, poseError(a * b, ta * tb));
+            inverseError = std::max(inverseError, poseError(a.inverse(), ta.inverse()));
+            inverseTimesError = std::max(inverseTimesError, poseError(a.inverseTimes(b), ta.inverseTimes(tb)));
+            tf2::Quaternion rotation = ta.getRotation();
+            quaternionError = std::max(quaternionError,
+                poseError(Se2Pose::fromQuaternion(a.x(), a.y(), rotation.x(), rotation.y(), rotation.z(), rotation.w()), ta));
+            interpolateError = std::max(interpolateError, interpolationError(a, b, fraction(rng)));
+
+            increments.clear();
+            tf2::Transform composed;
+            composed.setIdentity();
+            for (int n = 0; n < kIncrements; n++)
+            {
+                increments.push_back(step(rng), step(rng), 5 * step(rng));
+                composed = composed * toTf(Se2Pose(increments.dx[n], increments.dy[n], increments.dyaw[n]));
+            }
+            integrateError = std::max(integrateError, poseError(increments.integrate(scratch), composed));
+        }
+
+        // headings on both sides of the wrap, the shortest arc crosses it
+        const double wraps[][2] = { { M_PI - 0.1, -M_PI + 0.1 }, { -M_PI + 0.1, M_PI - 0.1 }, { M_PI - 1e-6, -M_PI + 1e-6 }, { 3.0, -2.0 } };
+        for (const auto& wrap : wraps)
+        {
+            for (int i = 0; i <= 4; i++)
+                interpolateError = std::max(interpolateError, interpolationError(Se2Pose(1.0, -2.0, wrap[0]), Se2Pose(-3.0, 4.0, wrap[1]), i * 0.25));
+        }
+
+        bool ok = composeError < kTolerance && inverseError < kTolerance && inverseTimesError < kTolerance
+            && quaternionError < kTolerance && interpolateError < kTolerance && integrateError < kFloatTolerance;
+        std::printf("se2 against tf2 over %d random poses, max error compose %.2g, inverse %.2g, inverseTimes %.2g, "
+            "fromQuaternion %.2g, interpolate %.2g, integrate %d %.2g: %s\n\n", kCases, composeError, inverseError, inverseTimesError,
+            quaternionError, interpolateError, kIncrements, integrateError, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    // Scans out of ScanConverter through ScanEncoder and ScanDecoder, over enough consecutive scans
+    // for keyframes and delta frames, single echo, every echo as layers, and a 270 degree laser. The
+    // ranges come back within half the range resolution, the angles within the angle tolerance, and
+    // the rest as it was.
+    bool checkScanCodec()
+    {
+        const int kScans = 45;
+        const int kKeyframeInterval = 20;
+
+        struct Case
+        {
+            const char* name;
+            int beams;
+            int echoCount;      // 0 single echo, else EchoSelectionAll
+            bool partial;       // 270 degrees centered on the front, else 360
+        };
+        const Case cases[] = {
+            { "single", 720, 0, false },
+            { "single", 1440, 0, false },
+            { "multi3/all", 720, 3, false },
+            { "single/270", 1440, 0, true },
+            { "multi3/all/270", 720, 3, true },
+        };
+
+        bool ok = true;
+        for (const Case& c : cases)
+        {
+            ScanConverter converter;
+            converter.setEchoSelection(c.echoCount ? EchoSelectionAll : EchoSelectionFirst);
+            ScanEncoder encoder(kKeyframeInterval);
+            ScanDecoder decoder;
+            std::vector<std::uint8_t> frame;
+            double rangeError = 0.0;
+            double angleError = 0.0;
+            int mismatches = 0;
+            for (int i = 0; i < kScans; i++)
+            {
+                SyntheticScan synthetic(c.beams, c.echoCount, i);
+                const int first = c.partial ? c.beams / 8 : 0;
+                if (c.partial)
+                {
+                    synthetic.layout.angleMin += synthetic.layout.angleIncrement * first;
+                    synthetic.layout.count = c.beams - 2 * first;
+                }
+
+                rpos::message::lidar::LidarScan scan;
+                if (c.echoCount)
+                {
+                    auto echoesOf = [&](int beam) -> const std::vector<float>& { return synthetic.echoes[first + beam]; };
+                    auto intensitiesOf = [&](int beam) -> const std::vector<float>* { return &synthetic.intensities[first + beam]; };
+                    converter.convertMultiEcho(synthetic.layout, echoesOf, intensitiesOf, scan, ScanConverter::NoPointHandler());
+                }
+                else
+                {
+                    converter.convert(synthetic.layout, synthetic.ranges.data() + first, scan);
+                }
+
+                encoder.encode(scan, frame);
+                rpos::message::lidar::LidarScan decoded;
+                if (!decoder.decode(frame, decoded) || decoded.size() != scan.size())
+                {
+                    mismatches++;
+                    continue;
+                }
+                for (size_t n = 0; n < scan.size(); n++)
+                {
+                    rangeError = std::max(rangeError, double(std::fabs(decoded[n].dist - scan[n].dist)));
+                    angleError = std::max(angleError, double(std::fabs(decoded[n].angle - scan[n].angle)));
+                    if (decoded[n].quality != scan[n].quality || decoded[n].valid != scan[n].valid || decoded[n].layer != scan[n].layer)
+                        mismatches++;
+                }
+            }
+
+            // the float rounding of the quantized range on top of the quantization
+            bool pass = mismatches == 0 && rangeError <= ScanCodec::RangeResolution / 2 + 1e-5 && angleError <= ScanCodec::AngleTolerance;
+            std::printf("compact scan round trip, %-16s %5d beams, %d scans, max error range %.2g m, angle %.2g degree, "
+                "%d mismatches: %s\n", c.name, c.beams, kScans, rangeError, angleError, mismatches, pass ? "ok" : "FAILED");
+            ok = ok && pass;
+        }
+        std::printf("\n");
+        return ok;
+    }
+
+    void benchScans(double seconds)
+    {
+        const int beamCounts[] = { 360, 720, 1440, 2880, 5760, 11520 };
+
+        std::printf("%-22s %8s %12s %12s %12s %12s\n", "scan", "beams", "ns/scan", "allocs/scan", "scans/s", "Mbeams/s");
+        for (int beams : beamCounts)
+        {
+            SyntheticScan single(beams, 0);
+            SyntheticScan multi(beams, 3);
+            ReflexGuard reflexGuard;
+
+            struct Case
+            {
+                const char* name;
+                int mode;       // 0 single echo, 1 multi echo
+                EchoSelection selection;
+                bool reflex;
+            };
+            const Case cases[] = {
+                { "single", 0, EchoSelectionFirst, false },
+                { "single+reflex", 0, EchoSelectionFirst, true },
+                { "multi3/nearest", 1, EchoSelectionNearest, false },
+                { "multi3/strongest", 1, EchoSelectionStrongest, false },
+                { "multi3/all", 1, EchoSelectionAll, false },
+            };
+
+            for (const Case& c : cases)
+            {
+                ScanConverter converter;
+                converter.setEchoSelection(c.selection);
+                converter.setReflexGuard(c.reflex ? &reflexGuard : nullptr);
+
+                Result result;
+                if (c.mode == 0)
+                {
+                    result = measure(seconds, [&] {
+                        rpos::message::lidar::LidarScan scan;
+                        converter.convert(single.layout, single.ranges.data(), scan);
+                    });
+                }
+                else
+                {
+                    auto echoesOf = [&](int beam) -> const std::vector<float>& { return multi.echoes[beam]; };
+                    auto intensitiesOf = [&](int beam) -> const std::vector<float>* { return &multi.intensities[beam]; };
+                    result = measure(seconds, [&] {
+                        rpos::message::lidar::LidarScan scan;
+                        converter.convertMultiEcho(multi.layout, echoesOf, intensitiesOf, scan, ScanConverter::NoPointHandler());
+                    });
+                }
+                std::printf("%-22s %8d %12.0f %12.2f %12.0f %12.2f\n", c.name, beams,
+                    result.nsPerOp, result.allocationsPerOp, result.opsPerSecond, result.opsPerSecond * beams * 1e-6);
+            }
+        }
+    }
+
+    void benchRecording(double seconds)
+    {
+        const int beamCounts[] = { 720, 1440, 3200, 11520 };
+        const int kScans = 32;
+
+        std::printf("\n%-22s %8s %12s %12s %12s %12s\n", "recording", "beams", "bytes/scan", "ns/encode", "ns/decode", "encode MB/s");
+        for (int beams : beamCounts)
+        {
+            std::vector<rpos::message::lidar::LidarScan> scans(kScans);
+            for (int i = 0; i < kScans; i++)
+            {
+                SyntheticScan synthetic(beams, 0, i);
+                ScanConverter converter;
+                converter.convert(synthetic.layout, synthetic.ranges.data(), scans[i]);
+            }
+
+            // the specialization of the sdk, as written by SessionWriteStream
+            {
+                int next = 0;
+                size_t bytes = 0;
+                Result encode = measure(seconds, [&] {
+                    rpos::system::io::MemoryWriteStream stream;
+                    rpos::system::diagnosis::serialization::write(stream, scans[next++ % kScans]);
+                    bytes = stream.size();
+                });
+                rpos::system::io::MemoryWriteStream encoded;
+                rpos::system::diagnosis::serialization::write(encoded, scans[0]);
+                Result decode = measure(seconds, [&] {
+                    rpos::system::io::MemoryReadStream stream(encoded.buffer(), encoded.size(), rpos::system::io::MemoryReadStream::MemoryReadStreamFlagBorrowBuffer);
+                    rpos::message::lidar::LidarScan scan;
+                    rpos::system::diagnosis::serialization::read(stream, scan);
+                });
+                std::printf("%-22s %8d %12zu %12.0f %12.0f %12.1f\n", "sdk serialization", beams, bytes,
+                    encode.nsPerOp, decode.nsPerOp, bytes * encode.opsPerSecond * 1e-6);
+            }
+
+            // a run of consecutive scans, so the deltas and keyframes weigh as in a recording
+            {
+                ScanEncoder encoder;
+                std::vector<std::uint8_t> frame;
+                int next = 0;
+                size_t bytes = 0;
+                std::uint64_t frames = 0;
+                Result encode = measure(seconds, [&] {
+                    encoder.encode(scans[next++ % kScans], frame);
+                    bytes += frame.size();
+                    frames++;
+                });
+
+                ScanEncoder sequenceEncoder;
+                std::vector<std::vector<std::uint8_t> > encoded(kScans);
+                for (int i = 0; i < kScans; i++)
+                    sequenceEncoder.encode(scans[i], encoded[i]);
+                ScanDecoder decoder;
+                rpos::message::lidar::LidarScan scan;
+                next = 0;
+                Result decode = measure(seconds, [&] {
+                    if (next % kScans == 0)
+                        decoder.reset();
+                    decoder.decode(encoded[next++ % kScans], scan);
+                });
+                std::printf("%-22s %8d %12.0f %12.0f %12.0f %12.1f\n", "compact", beams, double(bytes) / frames,
+                    encode.nsPerOp, decode.nsPerOp, double(bytes) / frames * encode.opsPerSecond * 1e-6);
+            }
+        }
+    }
+
+    // the same operations through Se2Pose and through the tf2 transforms
+    void benchSe2Pose(double seconds)
+    {
+        const int kPoses = 64;
+        const int kIncrements = 100;
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<double> position(-50.0, 50.0);
+        std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+        std::uniform_real_distribution<float> step(-0.02f, 0.02f);
+        std::vector<Se2Pose> poses;
+        std::vector<tf2::Transform> transforms;
+        std::vector<tf2::Quaternion> rotations;     // as carried by the odometry messages
+        for (int i = 0; i < kPoses; i++)
+        {
+            poses.push_back(Se2Pose(position(rng), position(rng), angle(rng)));
+            transforms.push_back(toTf(poses.back()));
+            rotations.push_back(transforms.back().getRotation());
+        }
+        DeadReckonIncrements increments;
+        for (int n = 0; n < kIncrements; n++)
+            increments.push_back(step(rng), step(rng), step(rng));
+        std::vector<float> scratch;
+
+        std::printf("\n%-22s %12s %12s\n", "pose math", "se2 ns/op", "tf2 ns/op");
+        volatile double sink = 0.0;
+        int next = 0;
+        auto report = [](const char* name, const Result& se2, const Result& tf) {
+            std::printf("%-22s %12.1f %12.1f\n", name, se2.nsPerOp, tf.nsPerOp);
+        };
+
+        Result se2 = measure(seconds, [&] {
+            next = (next + 1) % kPoses;
+            sink = sink + (poses[next] * poses[(next + 1) % kPoses]).x();
+        });
+        Result tf = measure(seconds, [&] {
+            next = (next + 1) % kPoses;
+            sink = sink + (transforms[next] * transforms[(next + 1) % kPoses]).getOrigin().x();
+        });
+        report("compose", se2, tf);
+
+        se2 = measure(seconds, [&] {
+            next = (next + 1) % kPoses;
+            sink = sink + poses[next].inverse().x();
+        });
+        tf = measure(seconds, [&] {
+            next = (next + 1) % kPoses;
+            sink = sink + transforms[next].inverse().getOrigin().x();
+        });
+        report("inverse", se2, tf);
+
+        // odometry delta as getDeadReckon computes it, from the position and quaternion of two messages
+        se2 = measure(seconds, [&] {
+            next = (next + 1) % kPoses;
+            const tf2::Quaternion& q = rotations[next];
+            Se2Pose pose = Se2Pose::fromQuaternion(poses[next].x(), poses[next].y(), q.x(), q.y(), q.z(), q.w());
+            sink = sink + poses[(next + 1) % kPoses].inverseTimes(pose).yaw();
+        });
+        tf = measure(seconds, [&] {
+            next = (next + 1) % kPoses;
+            tf2::Transform pose;
+            pose.setOrigin(tf2::Vector3(poses[next].x(), poses[next].y(), 0.0));
+            pose.setRotation(rotations[next]);
+            sink = sink + yawOf(transforms[(next + 1) % kPoses].inverseTimes(pose));
+        });
+        report("odometry delta", se2, tf);
+
+        se2 = measure(seconds, [&] {
+            sink = sink + increments.integrate(scratch).yaw();
+        });
+        tf = measure(seconds, [&] {
+            tf2::Transform composed;
+            composed.setIdentity();
+            for (int n = 0; n < kIncrements; n++)
+            {
+                tf2::Quaternion rotation;
+                rotation.setRPY(0.0, 0.0, increments.dyaw[n]);
+                composed = composed * tf2::Transform(rotation, tf2::Vector3(increments.dx[n], increments.dy[n], 0.0));
+            }
+            sink = sink + composed.getOrigin().x();
+        });
+        report("integrate 100", se2, tf);
+    }
+
+    void benchOdometry(double seconds)
+    {
+        std::mt19937 rng(1);
+        std::normal_distribution<float> noise(0.f, 0.001f);
+
+        std::printf("\n%-22s %8s %12s %12s %12s\n", "odometry", "batch", "ns/op", "allocs/op", "ops/s");
+
+        // a fetch integrates every deadreckon increment received since the previous one
+        const int batches[] = { 1, 10, 100, 1000 };
+        for (int batch : batches)
+        {
+            DeadReckonIncrements increments;
+            for (int i = 0; i < batch; i++)
+                increments.push_back(0.002f + noise(rng), noise(rng), 0.001f + noise(rng));
+            std::vector<float> scratch;
+            volatile double sink = 0.0;
+            Result result = measure(seconds, [&] {
+                sink = sink + increments.integrate(scratch).yaw();
+            });
+            std::printf("%-22s %8d %12.1f %12.2f %12.0f\n", "deadreckon integrate", batch, result.nsPerOp, result.allocationsPerOp, result.opsPerSecond);
+        }
+
+        // accumulated odometry, decoded and differentiated at every fetch
+        {
+            PoseDelta delta;
+            double x = 0.0;
+            double yaw = 0.0;
+            volatile double sink = 0.0;
+            Result result = measure(seconds, [&] {
+                x += 0.002;
+                yaw += 0.001;
+                Se2Pose pose = Se2Pose::fromQuaternion(x, 0.5 * x, 0.0, 0.0, std::sin(yaw / 2), std::cos(yaw / 2));
+                sink = sink + delta.next(pose).x();
+            });
+            std::printf("%-22s %8d %12.1f %12.2f %12.0f\n", "odometry delta", 1, result.nsPerOp, result.allocationsPerOp, result.opsPerSecond);
+        }
+
+        // one complementary filter step per imu sample
+        {
+            YawFusion fusion(2.0);
+            double x = 0.0;
+            double gyroYaw = 0.0;
+            std::int64_t now = 0;
+            Result result = measure(seconds, [&] {
+                x += 0.002;
+                gyroYaw += 0.001 + noise(rng);
+                now += 5000;
+                fusion.step(Se2Pose(x, 0.0, 0.001 * (now / 5000)), gyroYaw, now);
+            });
+            std::printf("%-22s %8d %12.1f %12.2f %12.0f\n", "imu yaw fusion", 1, result.nsPerOp, result.allocationsPerOp, result.opsPerSecond);
+        }
+
+        // the fused heading depends on the gyro increments only, not on the yaw accumulated before them,
+        // as long as the integral handed to the fusion keeps its precision
+        {
+            const double accumulated = 1e4;
+            YawFusion fresh(2.0);
+            YawFusion shifted(2.0);
+            double gyroYaw = 0.0;
+            double maxError = 0.0;
+            for (int i = 0; i < 200 * 60; i++)
+            {
+                gyroYaw += 0.001 + noise(rng);
+                Se2Pose odom(0.002 * i, 0.0, 0.001 * i);
+                fresh.step(odom, gyroYaw, std::int64_t(i) * 5000);
+                shifted.step(odom, gyroYaw + accumulated, std::int64_t(i) * 5000);
+                double error = fresh.fused().yaw() - shifted.fused().yaw();
+                maxError = std::max(maxError, std::fabs(std::atan2(std::sin(error), std::cos(error))));
+            }
+            std::printf("%-22s yaw error %.3g rad after %.0f rad accumulated\n", "imu yaw fusion", maxError, accumulated);
+        }
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 0.5;
+    if (argc > 1)
+        seconds = std::atof(argv[1]);
+    if (seconds <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [seconds per case]\n", argv[0]);
+        return 1;
+    }
+
+    bool ok = checkReflexGuard();
+    ok = checkSe2Pose() && ok;
+    ok = checkScanCodec() && ok;
+    benchScans(seconds);
+    benchRecording(seconds);
+    benchSe2Pose(seconds);
+    benchOdometry(seconds);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+// Benchmark of the bridge path from a published ROS message to the pseudo devices, up to the point
+// where they hand data to the any2tcp bridge server. It is not end to end: the TCP hop through the
+// bridge server (port 9310) and the slamware side of it are excluded, the framing of that protocol
+// is not part of the SDK headers.
+//
+// The stand-in slamware client attaches in-process to the RPLidar virtual device through its request
+// context, the interface the bridge server serializes onto the socket, and starts a scan as a client
+// would. Movement estimations are fetched with getDeadReckon directly, not through the interchip
+// estimation path of the base device.
+// Synthetic streams come from LoadGenerator, the last beam of every scan carries its sequence
+// number so its arrival can be matched with its publish time. Movement estimations are fetched at
+// the slamware polling rate and their age is measured against the odometry stamp.
+//
+// With stages > 1 the scan, odometry and IMU rates are doubled at every stage, and the first stage
+// where scans are dropped or the latency degrades is reported.
+//
+// Private parameters: beams (720), scan_rate (10 Hz), odom_rate (50 Hz), imu_rate (0 Hz), jitter (0.05),
+// fetch_rate (50 Hz), stages (1), stage_duration (10 s)
+
+#include "load_generator.h"
+#include "ros1_node.h"
+#include <rpos/system/util/time_util.h>
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    using namespace rp::slamware::utils;
+
+    // RPLidar protocol requests
+    const std::uint8_t kCmdStop = 0x25;
+    const std::uint8_t kCmdScan = 0x20;
+
+    // a stage degrades once it drops more scans than this ratio, or its p99 latency grows by this factor over the first stage
+    const double kDegradedDropRatio = 0.01;
+    const double kDegradedLatencyFactor = 2.0;
+
+    std::int64_t nowUs()
+    {
+        return rpos::system::util::high_resolution_clock::get_time_in_us();
+    }
+
+    std::int64_t percentile(std::vector<std::int64_t>& samples, double ratio)
+    {
+        if (samples.empty())
+            return 0;
+        std::sort(samples.begin(), samples.end());
+        return samples[std::min(samples.size() - 1, size_t(samples.size() * ratio))];
+    }
+
+    class ClientLidarDevice : public PseudoRPLidarDevice
+    {
+    protected:
+        // callback mode, scans are pushed by Ros1Node
+        virtual bool getScanData(rpos::message::lidar::LidarScan&) { return false; }
+    };
+
+    struct StageResult
+    {
+        double scanRate;
+        double odometryRate;
+        std::uint64_t received;
+        std::uint64_t dropped;
+        double scansPerSecond;
+        std::int64_t latencyP50;
+        std::int64_t latencyP99;
+        std::int64_t latencyMax;
+        std::int64_t estimationAgeP99;
+    };
+
+    // the slamware end of the lidar service, records the arrival of every scan
+    class ScanConsumer : public IRPLidarVirtualDevice::IRequestContext
+    {
+    public:
+        explicit ScanConsumer(float markerAngle)
+            : markerAngle_(markerAngle)
+        {
+            for (int i = 0; i < LoadGenerator::MarkerModulo; i++)
+                publishTime_[i].store(0);
+            reset();
+        }
+
+        void onPublish(int id, std::int64_t time)
+        {
+            publishTime_[id].store(time, std::memory_order_release);
+        }
+
+        virtual void reply(std::uint8_t, std::uint8_t, const void*, size_t) {}
+        virtual void replyError(std::uint16_t errorCode)
+        {
+            std::fprintf(stderr, "lidar request failed: %04x\n", errorCode);
+        }
+        virtual void initDataPacker(std::uint8_t) {}
+
+        virtual void sendScanData(const rpos::message::lidar::LidarScan& data, bool)
+        {
+            std::int64_t arrival = nowUs();
+            int id = findMarker_(data);
+            if (id < 0)
+                return;
+
+            std::lock_guard<std::mutex> lkGuard(lock_);
+            if (lastId_ >= 0)
+                dropped_ += (id - lastId_ - 1 + LoadGenerator::MarkerModulo) % LoadGenerator::MarkerModulo;
+            lastId_ = id;
+            if (!received_)
+                firstArrival_ = arrival;
+            lastArrival_ = arrival;
+            received_++;
+            latencies_.push_back(arrival - publishTime_[id].load(std::memory_order_acquire));
+        }
+
+        void reset()
+        {
+            std::lock_guard<std::mutex> lkGuard(lock_);
+            lastId_ = -1;
+            received_ = 0;
+            dropped_ = 0;
+            firstArrival_ = 0;
+            lastArrival_ = 0;
+            latencies_.clear();
+        }
+
+        void takeStage(StageResult& result)
+        {
+            std::lock_guard<std::mutex> lkGuard(lock_);
+            double seconds = (lastArrival_ - firstArrival_) * 1e-6;
+            result.received = received_;
+            result.dropped = dropped_;
+            result.scansPerSecond = (received_ > 1 && seconds > 0) ? (received_ - 1) / seconds : 0.0;
+            result.latencyP50 = percentile(latencies_, 0.5);
+            result.latencyP99 = percentile(latencies_, 0.99);
+            result.latencyMax = latencies_.empty() ? 0 : latencies_.back();
+        }
+
+    private:
+        // the scan is in increasing angle order, the marker is the point nearest to its angle
+        int findMarker_(const rpos::message::lidar::LidarScan& data) const
+        {
+            auto it = std::lower_bound(data.begin(), data.end(), markerAngle_, [](const rpos::message::lidar::LidarScanPoint& p, float angle) {
+                return p.angle < angle;
+            });
+            if (it != data.begin() && (it == data.end() || std::fabs((it - 1)->angle - markerAngle_) < std::fabs(it->angle - markerAngle_)))
+                --it;
+            return it == data.end() ? -1 : LoadGenerator::markerId(it->dist);
+        }
+
+    private:
+        const float markerAngle_;
+        std::atomic<std::int64_t> publishTime_[LoadGenerator::MarkerModulo];
+        std::mutex lock_;
+        int lastId_;
+        std::uint64_t received_;
+        std::uint64_t dropped_;
+        std::int64_t firstArrival_;
+        std::int64_t lastArrival_;
+        std::vector<std::int64_t> latencies_;
+    };
+
+}
+
+int main(int argc, char** argv)
+{
+    Ros1Node rosNode(argc, argv, "slamware_ros_bridge_device_bench");
+    ros::NodeHandle nhPrivate("~");
+    double imuRate = 0.0;
+    double fetchRate = 50.0;
+    int stages = 1;
+    double stageDuration = 10.0;
+    nhPrivate.getParam("imu_rate", imuRate);
+    nhPrivate.getParam("fetch_rate", fetchRate);
+    nhPrivate.getParam("stages", stages);
+    nhPrivate.getParam("stage_duration", stageDuration);
+
+    RosNodeConfig config;
+    rosNode.initConfig(config);
+
+    LoadGenerator::Config loadConfig;
+    loadConfig.scanTopic = config.scan_sub_topic;
+    loadConfig.odometryTopic = config.odometry_sub_topic;
+    loadConfig.imuTopic = imuRate > 0 ? config.imu_sub_topic : std::string();
+    loadConfig.accumulatedOdometry = true;
+    loadConfig.beams = 720;
+    loadConfig.scanRate = 10.0;
+    loadConfig.odometryRate = 50.0;
+    loadConfig.imuRate = imuRate;
+    loadConfig.jitter = 0.05;
+    loadConfig.markScans = true;
+    nhPrivate.getParam("beams", loadConfig.beams);
+    nhPrivate.getParam("scan_rate", loadConfig.scanRate);
+    nhPrivate.getParam("odom_rate", loadConfig.odometryRate);
+    nhPrivate.getParam("jitter", loadConfig.jitter);
+
+    boost::shared_ptr<ClientLidarDevice> lidarDevice = boost::make_shared<ClientLidarDevice>();
+    rosNode.registerLidarDevice(lidarDevice);
+    rosNode.subscribe(config.scan_sub_topic, 1, MsgTypeScan);
+    rosNode.subscribe(config.odometry_sub_topic, 10, MsgTypeOdometry);
+    if (!loadConfig.imuTopic.empty())
+        rosNode.subscribe(config.imu_sub_topic, 10, MsgTypeImu);
+
+    ros::NodeHandle nh;
+    LoadGenerator generator(nh, loadConfig);
+    ScanConsumer consumer(generator.markerAngle());
+    generator.setScanPublishedCallback([&](int id, std::int64_t time) { consumer.onPublish(id, time); });
+    lidarDevice->handleRequest(kCmdScan, nullptr, 0, consumer);
+
+    std::thread spinner([&] { rosNode.spin(false); });
+    std::this_thread::sleep_for(std::chrono::seconds(1));   // let the subscriptions connect
+
+    std::vector<StageResult> results;
+    for (int stage = 0; stage < std::max(stages, 1) && ros::ok(); stage++)
+    {
+        StageResult result;
+        double scale = std::pow(2.0, stage);
+        result.scanRate = loadConfig.scanRate * scale;
+        result.odometryRate = loadConfig.odometryRate * scale;
+        consumer.reset();
+        generator.start(result.scanRate, result.odometryRate, loadConfig.imuRate * scale);
+
+        // the slamware side polls the movement estimation
+        std::vector<std::int64_t> estimationAges;
+        const auto fetchPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / fetchRate));
+        const auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(stageDuration));
+        auto nextFetch = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() < end && ros::ok())
+        {
+            std::uint64_t timestamp = 0;
+            rosNode.getDeadReckon(timestamp);
+            if (timestamp)
+                estimationAges.push_back(nowUs() - std::int64_t(timestamp));
+            nextFetch += fetchPeriod;
+            std::this_thread::sleep_until(nextFetch);
+        }
+
+        generator.stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));    // drain the scans in flight
+        consumer.takeStage(result);
+        result.estimationAgeP99 = percentile(estimationAges, 0.99);
+        results.push_back(result);
+    }
+
+    lidarDevice->handleRequest(kCmdStop, nullptr, 0, consumer);
+    ros::shutdown();
+    spinner.join();
+    rosNode.clear();
+
+    std::printf("beams %d, fetch rate %.1f Hz, %.1f s per stage, latencies in us\n", loadConfig.beams, fetchRate, stageDuration);
+    std::printf("%6s %10s %10s %10s %10s %10s %10s %10s %10s %14s\n", "stage", "scan Hz", "odom Hz", "received", "dropped",
+        "scans/s", "p50", "p99", "max", "estimation p99");
+    int degradedStage = -1;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const StageResult& r = results[i];
+        std::printf("%6d %10.1f %10.1f %10llu %10llu %10.1f %10lld %10lld %10lld %14lld\n", int(i), r.scanRate, r.odometryRate,
+            (unsigned long long)r.received, (unsigned long long)r.dropped, r.scansPerSecond,
+            (long long)r.latencyP50, (long long)r.latencyP99, (long long)r.latencyMax, (long long)r.estimationAgeP99);
+
+        double dropRatio = (r.received + r.dropped) ? double(r.dropped) / (r.received + r.dropped) : 1.0;
+        if (degradedStage < 0 && (dropRatio > kDegradedDropRatio || r.latencyP99 > kDegradedLatencyFactor * results[0].latencyP99))
+            degradedStage = int(i);
+    }
+    if (results.size() > 1)
+    {
+        if (degradedStage >= 0)
+            std::printf("degraded from stage %d, scan %.1f Hz, odometry %.1f Hz\n", degradedStage, results[degradedStage].scanRate, results[degradedStage].odometryRate);
+        else
+            std::printf("no degradation up to stage %d\n", int(results.size()) - 1);
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Synthetic sensor load for the bridge. Publishes scan, odometry and IMU streams at the configured
+// rates; with stages > 1 every rate is doubled after each stage_duration, so the stage where the
+// bridge stats degrade can be read from its log.
+//
+// Private parameters: scan_topic (scan), odometry_topic (odom), imu_topic (empty), accumulated_odometry (true),
+// beams (720), scan_rate (10 Hz), odom_rate (50 Hz), imu_rate (200 Hz), jitter (0.05), stages (1), stage_duration (10 s)
+
+#include "load_generator.h"
+#include <cmath>
+
+using namespace rp::slamware::utils;
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "slamware_ros_bridge_load_generator");
+    ros::NodeHandle nh;
+    ros::NodeHandle nhPrivate("~");
+
+    LoadGenerator::Config config;
+    config.scanTopic = "scan";
+    config.odometryTopic = "odom";
+    config.accumulatedOdometry = true;
+    config.beams = 720;
+    config.scanRate = 10.0;
+    config.odometryRate = 50.0;
+    config.imuRate = 200.0;
+    config.jitter = 0.05;
+    config.markScans = false;
+    int stages = 1;
+    double stageDuration = 10.0;
+    nhPrivate.getParam("scan_topic", config.scanTopic);
+    nhPrivate.getParam("odometry_topic", config.odometryTopic);
+    nhPrivate.getParam("imu_topic", config.imuTopic);
+    nhPrivate.getParam("accumulated_odometry", config.accumulatedOdometry);
+    nhPrivate.getParam("beams", config.beams);
+    nhPrivate.getParam("scan_rate", config.scanRate);
+    nhPrivate.getParam("odom_rate", config.odometryRate);
+    nhPrivate.getParam("imu_rate", config.imuRate);
+    nhPrivate.getParam("jitter", config.jitter);
+    nhPrivate.getParam("stages", stages);
+    nhPrivate.getParam("stage_duration", stageDuration);
+
+    LoadGenerator generator(nh, config);
+    if (stages <= 1)
+    {
+        generator.start(config.scanRate, config.odometryRate, config.imuRate);
+        ros::spin();
+    }
+    for (int stage = 0; stage < stages && ros::ok(); stage++)
+    {
+        double scale = std::pow(2.0, stage);
+        ROS_INFO("stage %d: %d beams, scan %.1f Hz, odometry %.1f Hz, imu %.1f Hz", stage, config.beams,
+            config.scanRate * scale, config.odometryRate * scale, config.imuRate * scale);
+        generator.start(config.scanRate * scale, config.odometryRate * scale, config.imuRate * scale);
+        ros::WallDuration(stageDuration).sleep();
+    }
+    generator.stop();
+    return 0;
+}
@@ -0,0 +1,65 @@
+// Replays a session recorded with record_path through the pseudo devices and the bridge server,
+// without ROS, so slamware can be regression tested and benchmarked against a fixed input.
+//
+// usage: slamware_ros_bridge_replay <recording directory> [rate] [start delay]
+//   rate: 1 for real time (default), N for N times faster, 0 or max for as fast as possible
+//   start delay: seconds to wait for slamware to connect before replaying (default 5)
+
+#include "devices_manager_service.h"
+#include "replay_node_service.h"
+#include <rpos/system/util/log.h>
+#include <rpos/context/application_context.h>
+#include <boost/make_shared.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+rpos::context::ApplicationContext context;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <recording directory> [rate] [start delay]\n", argv[0]);
+        return 1;
+    }
+
+    rp::slamware::utils::ReplayNodeService::Options options;
+    options.directory = argv[1];
+    options.rate = 1.0;
+    options.startDelay = 5.0;
+    if (argc > 2)
+        options.rate = std::strcmp(argv[2], "max") == 0 ? 0.0 : std::atof(argv[2]);
+    if (argc > 3)
+        options.startDelay = std::atof(argv[3]);
+    if (options.rate < 0 || options.startDelay < 0)
+    {
+        std::fprintf(stderr, "usage: %s <recording directory> [rate] [start delay]\n", argv[0]);
+        return 1;
+    }
+
+    auto logManager = rpos::system::util::LogManager::defaultManager();
+    logManager->addConsoleAppender();
+
+    auto replayService = boost::make_shared<rp::slamware::utils::ReplayNodeService>(options);
+    auto deviceManagerService = boost::make_shared<rp::slamware::utils::DevicesManagerService>();
+    context.addService(replayService);
+    context.addService(deviceManagerService);
+    if (!context.startServices())
+    {
+        context.stopServices();
+        return 1;
+    }
+
+    replayService->spin();
+    context.stopServices();
+
+    rp::slamware::utils::ReplayNodeService::Summary s = replayService->summary();
+    double seconds = s.replayDuration * 1e-6;
+    std::printf("replayed %.1f s of recording in %.1f s (%.1fx)\n", s.recordedDuration * 1e-6, seconds,
+        seconds > 0 ? s.recordedDuration * 1e-6 / seconds : 0.0);
+    std::printf("scans %llu (%.1f scans/s), estimations %llu, motion requests %llu recorded, %llu live\n",
+        (unsigned long long)s.scans, seconds > 0 ? s.scans / seconds : 0.0, (unsigned long long)s.estimations,
+        (unsigned long long)s.recordedMotions, (unsigned long long)s.liveMotions);
+    return 0;
+}
@@ -10,20 +10,120 @@ namespace rp { namespace slamware { namespace utils {
     void RosNodeConfig::resetToDefault()
     {
         scan_sub_topic = "scan";
+        is_multi_echo_scan = false;
+        echo_selection = EchoSelectionFirst;
         odometry_sub_topic = "odom";
         is_accumulated_odometry = true;
+        imu_sub_topic = "";
+        enable_imu_fusion = false;
+        imu_fusion_time_constant = 2.0;
+        range_sub_topics.clear();
+        range_timeout = 0.5;
+        battery_sub_topic = "";
+        dock_sub_topic = "";
         velocity_pub_topic = "cmd_vel";
+        velocity_output = VelocityOutputTwist;
+        wheel_span = 0.3;
         enable_shared_memory_lidar = false;
+        stats_report_interval = 10.0;
+        clock_sync_interval = 1.0;
+        use_sim_time = false;
+        reflex_stop_enabled = false;
+        reflex_robot_radius = 0.2;
+        reflex_stop_margin = 0.05;
+        reflex_deceleration = 1.0;
+        reflex_reaction_time = 0.1;
+        reflex_scan_timeout = 0.5;
+        reflex_laser_yaw = 0.0;
+        record_path = "";
+        record_segment_size = 64;
+        record_space_limit = 1024;
+        record_queue_size = 1024;
+        record_compact_scan = true;
+        record_write_buffer_size = 1024;
+        record_write_buffers = 4;
+        record_flush_interval = 1.0;
+        flight_recorder_path = "";
+        flight_recorder_duration = 30.0;
+        flight_recorder_size = 64;
+        flight_recorder_scan_gap = 0.5;
+        flight_recorder_client_gap = 1.0;
+        flight_recorder_odometry_jump = 0.5;
+        flight_recorder_rotation_jump = 1.0;
     }
 
 #if ROS_DISTRO_VERSION == 1
     void RosNodeConfig::setBy(const ros::NodeHandle& nhRos)
     {
         nhRos.getParam("scan_sub_topic", scan_sub_topic);
+        nhRos.getParam("is_multi_echo_scan", is_multi_echo_scan);
+
+        std::string echoSelection;
+        if (nhRos.getParam("echo_selection", echoSelection))
+        {
+            if (echoSelection == "first")
+                echo_selection = EchoSelectionFirst;
+            else if (echoSelection == "last")
+                echo_selection = EchoSelectionLast;
+            else if (echoSelection == "strongest")
+                echo_selection = EchoSelectionStrongest;
+            else if (echoSelection == "nearest")
+                echo_selection = EchoSelectionNearest;
+            else if (echoSelection == "all")
+                echo_selection = EchoSelectionAll;
+            else
+                ROS_WARN("unknown echo_selection: %s, use first echo", echoSelection.c_str());
+        }
         nhRos.getParam("odometry_sub_topic", odometry_sub_topic);
         nhRos.getParam("is_accumulated_odometry", is_accumulated_odometry);
+        nhRos.getParam("imu_sub_topic", imu_sub_topic);
+        nhRos.getParam("enable_imu_fusion", enable_imu_fusion);
+        nhRos.getParam("imu_fusion_time_constant", imu_fusion_time_constant);
+        nhRos.getParam("range_sub_topics", range_sub_topics);
+        nhRos.getParam("range_timeout", range_timeout);
+        nhRos.getParam("battery_sub_topic", battery_sub_topic);
+        nhRos.getParam("dock_sub_topic", dock_sub_topic);
         nhRos.getParam("velocity_pub_topic", velocity_pub_topic);
+        nhRos.getParam("wheel_span", wheel_span);
+
+        std::string velocityOutput;
+        if (nhRos.getParam("velocity_output", velocityOutput))
+        {
+            if (velocityOutput == "twist")
+                velocity_output = VelocityOutputTwist;
+            else if (velocityOutput == "twist_stamped")
+                velocity_output = VelocityOutputTwistStamped;
+            else if (velocityOutput == "wheels")
+                velocity_output = VelocityOutputWheels;
+            else
+                ROS_WARN("unknown velocity_output: %s, use twist", velocityOutput.c_str());
+        }
         nhRos.getParam("enable_shared_memory_lidar", enable_shared_memory_lidar);
+        nhRos.getParam("stats_report_interval", stats_report_interval);
+        nhRos.getParam("clock_sync_interval", clock_sync_interval);
+        nhRos.getParam("/use_sim_time", use_sim_time);
+        nhRos.getParam("reflex_stop_enabled", reflex_stop_enabled);
+        nhRos.getParam("reflex_robot_radius", reflex_robot_radius);
+        nhRos.getParam("reflex_stop_margin", reflex_stop_margin);
+        nhRos.getParam("reflex_deceleration", reflex_deceleration);
+        nhRos.getParam("reflex_reaction_time", reflex_reaction_time);
+        nhRos.getParam("reflex_scan_timeout", reflex_scan_timeout);
+        nhRos.getParam("reflex_laser_yaw", reflex_laser_yaw);
+        nhRos.getParam("record_path", record_path);
+        nhRos.getParam("record_segment_size", record_segment_size);
+        nhRos.getParam("record_space_limit", record_space_limit);
+        nhRos.getParam("record_queue_size", record_queue_size);
+        nhRos.getParam("record_compact_scan", record_compact_scan);
+        nhRos.getParam("record_write_buffer_size", record_write_buffer_size);
+        nhRos.getParam("record_write_buffers", record_write_buffers);
+        nhRos.getParam("record_flush_interval", record_flush_interval);
+        nhRos.getParam("flight_recorder_path", flight_recorder_path);
+        nhRos.getParam("flight_recorder_duration", flight_recorder_duration);
+        nhRos.getParam("flight_recorder_size", flight_recorder_size);
+        nhRos.getParam("flight_recorder_scan_gap", flight_recorder_scan_gap);
+        nhRos.getParam("flight_recorder_client_gap", flight_recorder_client_gap);
+        nhRos.getParam("flight_recorder_odometry_jump", flight_recorder_odometry_jump);
+        nhRos.getParam("flight_recorder_rotation_jump", flight_recorder_rotation_jump);
     }
 #endif
 }}}
@@ -50,11 +50,17 @@ namespace rp { namespace slamware { namespace utils {
 
     bool RosBaseDevice::getExtendedSensorData(std::vector<BaseSensorData>& extendedSensorData)
     {
+        if (deviceManager_.expired())
+            return false;
+        deviceManager_.lock()->getExtendedSensorData(extendedSensorData);
         return true;
     }
     
     bool RosBaseDevice::getBaseStatus(BaseStatusData& data)
     {
+        if (deviceManager_.expired())
+            return false;
+        deviceManager_.lock()->getBaseStatus(data);
         return true;
     }
 
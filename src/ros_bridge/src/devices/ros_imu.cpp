@@ -0,0 +1,27 @@
+#include "devices/ros_imu.h"
+#include "devices_manager_service.h"
+
+namespace rp { namespace slamware { namespace utils {
+
+    RosImuDevice::RosImuDevice(boost::shared_ptr<DevicesManagerService> deviceManager)
+        : deviceManager_(deviceManager)
+    {
+        //
+    }
+
+    RosImuDevice::~RosImuDevice()
+    {
+        //
+    }
+
+    void RosImuDevice::getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData)
+    {
+        if (deviceManager_.expired())
+        {
+            sensorData.acc = sensorData.gyro = sensorData.gyroIntegral = sensorData.compass = rpos::core::Vector3f(0.f, 0.f, 0.f);
+            return;
+        }
+        deviceManager_.lock()->getImuAllSensorData(sensorData);
+    }
+
+}}}
@@ -1,6 +1,8 @@
 #include "devices_manager_service.h"
 #include "devices/ros_base.h"
 #include "devices/ros_rplidar.h"
+#include "devices/ros_imu.h"
+#include "trace_probes.h"
 #include <boost/make_shared.hpp>
 #include <chrono>
 
@@ -53,6 +55,21 @@ namespace rp { namespace slamware { namespace utils {
         rosNode_->getMovementEstimation(estimation);
     }
 
+    void DevicesManagerService::getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData)
+    {
+        rosNode_->getImuAllSensorData(sensorData);
+    }
+
+    void DevicesManagerService::getExtendedSensorData(std::vector<PseudoBaseDevice::BaseSensorData>& extendedSensorData)
+    {
+        rosNode_->getExtendedSensorData(extendedSensorData);
+    }
+
+    void DevicesManagerService::getBaseStatus(PseudoBaseDevice::BaseStatusData& data)
+    {
+        rosNode_->getBaseStatus(data);
+    }
+
     void DevicesManagerService::workThread_()
     {
         logger.info_out("device manager service thread begin.");
@@ -73,10 +90,19 @@ namespace rp { namespace slamware { namespace utils {
             return;
         }
 
+        const auto statsInterval = std::chrono::milliseconds(int64_t(rosNode_->config().stats_report_interval * 1000));
+        auto lastStatsTime = std::chrono::steady_clock::now();
         while (working_.load())
         {
+            BRIDGE_TRACE(heartbeat_begin);
             bridge_->heartBeat();
-            std::this_thread::sleep_for(std::chrono::milliseconds(threadDuration));
+            BRIDGE_TRACE(heartbeat_end);
+            if (statsInterval.count() > 0 && std::chrono::steady_clock::now() - lastStatsTime >= statsInterval)
+            {
+                lastStatsTime = std::chrono::steady_clock::now();
+                rosNode_->reportStats();
+            }
+            rosNode_->sleepFor(threadDuration * 1000);
         }
 
         logger.info_out("devices manager service stop bridge.");
@@ -108,6 +134,12 @@ namespace rp { namespace slamware { namespace utils {
         bridge_->addVirtualDevice("ctrlbus", "Control Bus", base_.get());
         rosNode_->registerLidarDevice(lidar_);
         rosNode_->registerBaseDevice(base_);
+
+        if (!rosNode_->config().imu_sub_topic.empty())
+        {
+            imu_ = boost::make_shared<RosImuDevice>(shared_from_this());
+            bridge_->addVirtualDevice("cp0", "IMU", imu_.get());
+        }
     }
 
     void DevicesManagerService::cleanup_()
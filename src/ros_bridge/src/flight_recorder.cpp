@@ -0,0 +1,300 @@
+#include "flight_recorder.h"
+#include "session_recorder.h"
+#include <rpos/message/diagnosis/lidar_messages_serialization.h>
+#include <rpos/message/diagnosis/base_messages_serialization.h>
+#include <rpos/system/io/segmented_loop_files_write_stream.h>
+#include <rpos/system/util/time_util.h>
+#include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <vector>
+
+namespace {
+
+    // a dump starts on the first frame after a mark, so this is the time resolution of the window
+    const std::int64_t kMarkInterval = 1000000;
+    // dumps taken while the dump thread is still writing, the newer triggers are dropped past this
+    const size_t kMaxPendingDumps = 2;
+    const size_t kDumpChunk = 64 * 1024;
+
+    std::int64_t nowUs()
+    {
+        return rpos::system::util::high_resolution_clock::get_time_in_us();
+    }
+
+    // local time to the millisecond, then the sequence of the dump and its reason
+    std::string dumpName(const std::string& reason, std::uint32_t sequence)
+    {
+        const std::int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::time_t now = std::time_t(nowMs / 1000);
+        std::tm local;
+        localtime_r(&now, &local);
+        char time[32];
+        std::strftime(time, sizeof(time), "%Y%m%d_%H%M%S", &local);
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s_%03d_%u_", time, int(nowMs % 1000), sequence);
+        return std::string(name) + reason;
+    }
+
+}
+
+namespace rp { namespace slamware { namespace utils {
+
+    rpos::system::util::LogScope FlightRecorder::logger("srv.flight_recorder");
+
+    FlightRecorder::FlightRecorder()
+        : enabled_(false)
+        , lastTimestamp_(0)
+        , lastScanTimestamp_(0)
+        , lastScanArrival_(0)
+        , lastEstimationArrival_(0)
+        , scanStalled_(false)
+        , clientStalled_(false)
+        , lastAutoDump_(0)
+        , dumpSequence_(0)
+        , dumpRequested_(false)
+        , dumpWorking_(false)
+    {
+    }
+
+    FlightRecorder::~FlightRecorder()
+    {
+        stop();
+    }
+
+    bool FlightRecorder::start(const Options& options)
+    {
+        stop();
+        if (options.path.empty())
+            return false;
+
+        options_ = options;
+        rpos::system::io::SnapshotLoopBufferMemoryWriteStream::Options ringOptions;
+        ringOptions.capcity = std::max<size_t>(options.capacity, kDumpChunk);
+        // the ring drops whole buffers, keep them small against the capacity
+        ringOptions.split_size = std::max<size_t>(ringOptions.capcity / 16, kDumpChunk);
+        ring_ = boost::make_shared<rpos::system::io::SnapshotLoopBufferMemoryWriteStream>(ringOptions);
+        writer_ = boost::make_shared<SessionWriteStream>(ring_);
+        marks_.clear();
+        lastTimestamp_ = 0;
+        lastScanTimestamp_ = 0;
+        lastScanArrival_ = 0;
+        lastEstimationArrival_ = 0;
+        scanStalled_ = false;
+        clientStalled_ = false;
+        lastAutoDump_ = 0;
+        dumpRequested_.store(false);
+
+        dumpWorking_ = true;
+        dumpWorker_ = std::thread(std::bind(&FlightRecorder::dumpThread_, this));
+        enabled_.store(true);
+        logger.info_out("flight recorder keeps %.1f s, %llu bytes at most, dumps to %s",
+            options.duration * 1e-6, (unsigned long long)ringOptions.capcity, options.path.c_str());
+        return true;
+    }
+
+    void FlightRecorder::stop()
+    {
+        enabled_.store(false);
+        {
+            std::lock_guard<std::mutex> lkGuard(dumpLock_);
+            dumpWorking_ = false;
+        }
+        dumpSignal_.notify_one();
+        if (dumpWorker_.joinable())
+            dumpWorker_.join();
+        writer_.reset();
+        ring_.reset();
+    }
+
+    void FlightRecorder::requestDump(const std::string& reason)
+    {
+        {
+            std::lock_guard<std::mutex> lkGuard(requestLock_);
+            requestReason_ = reason;
+        }
+        dumpRequested_.store(true);
+    }
+
+    void FlightRecorder::write(const char* topic, const rpos::message::Message<rpos::message::lidar::LidarScan>& scan)
+    {
+        append_(topic, scan);
+
+        const bool gap = options_.scanGap > 0 && lastScanTimestamp_ > 0 && !scanStalled_
+            && std::int64_t(scan.timestamp) - lastScanTimestamp_ > options_.scanGap;
+        lastScanTimestamp_ = std::int64_t(scan.timestamp);
+        lastScanArrival_ = nowUs();
+        scanStalled_ = false;
+        if (gap)
+            trigger_("scan_gap");
+    }
+
+    void FlightRecorder::write(const char* topic, const rpos::message::Message<rpos::message::base::MovementEstimation>& estimation)
+    {
+        append_(topic, estimation);
+
+        lastEstimationArrival_ = nowUs();
+        clientStalled_ = false;
+        const rpos::core::Vector2f& d = estimation.payload.positionDifference;
+        if ((options_.odometryJump > 0 && std::sqrt(d.x() * d.x() + d.y() * d.y()) > options_.odometryJump)
+            || (options_.rotationJump > 0 && std::fabs(estimation.payload.angularDifference) > options_.rotationJump))
+            trigger_("odometry_jump");
+    }
+
+    void FlightRecorder::write(const char* topic, const rpos::message::Message<rpos::message::base::MotionRequest>& request)
+    {
+        append_(topic, request);
+    }
+
+    void FlightRecorder::poll()
+    {
+        const std::int64_t now = nowUs();
+        if (options_.scanGap > 0 && lastScanArrival_ > 0 && !scanStalled_ && now - lastScanArrival_ > options_.scanGap)
+        {
+            scanStalled_ = true;
+            trigger_("scan_gap");
+        }
+        if (options_.clientGap > 0 && lastEstimationArrival_ > 0 && !clientStalled_ && now - lastEstimationArrival_ > options_.clientGap)
+        {
+            clientStalled_ = true;
+            trigger_("client_gap");
+        }
+
+        if (dumpRequested_.exchange(false))
+        {
+            std::string reason;
+            {
+                std::lock_guard<std::mutex> lkGuard(requestLock_);
+                reason.swap(requestReason_);
+            }
+            takeDump_(reason);
+        }
+    }
+
+    template <typename PayloadT>
+    void FlightRecorder::append_(const char* topic, const rpos::message::Message<PayloadT>& message)
+    {
+        lastTimestamp_ = std::max<std::int64_t>(lastTimestamp_, message.timestamp);
+        if (marks_.empty() || lastTimestamp_ >= marks_.back().time + kMarkInterval)
+        {
+            ring_->markSplit();
+            Mark mark;
+            mark.time = lastTimestamp_;
+            mark.offset = writer_->bytesWritten();
+            marks_.push_back(mark);
+        }
+        writer_->write(topic, message);
+
+        // forget the marks the ring already dropped
+        const std::uint64_t ringBegin = writer_->bytesWritten() - ring_->size();
+        while (marks_.size() > 1 && marks_[1].offset <= ringBegin)
+            marks_.pop_front();
+    }
+
+    void FlightRecorder::trigger_(const char* reason)
+    {
+        // the ring of a dump covers the triggers that follow it within the duration
+        const std::int64_t now = nowUs();
+        if (lastAutoDump_ > 0 && now - lastAutoDump_ < options_.duration)
+            return;
+        lastAutoDump_ = now;
+        takeDump_(reason);
+    }
+
+    void FlightRecorder::takeDump_(const std::string& reason)
+    {
+        // seal the buffer being appended to, the snapshot shares the buffers with the dump thread
+        ring_->markSplit();
+        Dump dump;
+        dump.snapshot = ring_->snapshot();
+        dump.offset = 0;
+        dump.name = dumpName(reason, dumpSequence_++);
+
+        const std::uint64_t ringBegin = writer_->bytesWritten() - dump.snapshot.size();
+        const std::int64_t windowBegin = lastTimestamp_ - options_.duration;
+        for (const Mark& mark : marks_)
+        {
+            if (mark.time < windowBegin)
+                continue;
+            if (mark.offset > ringBegin)
+                dump.offset = size_t(mark.offset - ringBegin);
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lkGuard(dumpLock_);
+            if (dumps_.size() >= kMaxPendingDumps)
+            {
+                logger.warn_out("flight recorder dump %s dropped, %d dumps still being written", dump.name.c_str(), (int)dumps_.size());
+                return;
+            }
+            dumps_.push_back(std::move(dump));
+        }
+        dumpSignal_.notify_one();
+    }
+
+    void FlightRecorder::dumpThread_()
+    {
+        std::unique_lock<std::mutex> lk(dumpLock_);
+        while (true)
+        {
+            dumpSignal_.wait(lk, [this] { return !dumps_.empty() || !dumpWorking_; });
+            if (dumps_.empty())
+                break;
+
+            Dump dump = std::move(dumps_.front());
+            dumps_.pop_front();
+            lk.unlock();
+            writeDump_(dump);
+            lk.lock();
+        }
+    }
+
+    void FlightRecorder::writeDump_(const Dump& dump)
+    {
+        const std::string directory = options_.path + "/" + dump.name;
+        boost::system::error_code ec;
+        boost::filesystem::create_directories(directory, ec);
+        if (ec)
+        {
+            logger.error_out("failed to create dump directory %s: %s", directory.c_str(), ec.message().c_str());
+            return;
+        }
+
+        // a single segment, readable by SessionReader and the replay tool
+        const size_t size = dump.snapshot.size() - std::min(dump.offset, dump.snapshot.size());
+        rpos::system::io::SegmentedLoopFilesWriteStream::Options segmentOptions;
+        segmentOptions.enableLoopSave = true;
+        segmentOptions.path = directory;
+        segmentOptions.ext = SessionRecorder::SegmentExtension;
+        segmentOptions.splitSize = int(std::max(size, kDumpChunk));
+        segmentOptions.spaceConstraint = std::uint64_t(segmentOptions.splitSize) * 2;
+        segmentOptions.quantityConstraint = 2;
+        rpos::system::io::SegmentedLoopFilesWriteStream stream(segmentOptions);
+        if (!stream.open())
+        {
+            logger.error_out("failed to open dump segment in %s", directory.c_str());
+            return;
+        }
+
+        std::vector<std::uint8_t> chunk(kDumpChunk);
+        size_t position = std::min(dump.offset, dump.snapshot.size());
+        while (position < dump.snapshot.size())
+        {
+            int n = dump.snapshot.read(position, chunk.data(), std::min(chunk.size(), dump.snapshot.size() - position));
+            if (n <= 0)
+                break;
+            stream.write(chunk.data(), n);
+            position += n;
+        }
+        stream.close();
+        logger.info_out("flight recorder dumped %llu bytes to %s", (unsigned long long)size, directory.c_str());
+    }
+
+}}}
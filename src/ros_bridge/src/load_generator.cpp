@@ -0,0 +1,271 @@
+#include "load_generator.h"
+#include "scan_converter.h"
+#include "se2_pose.h"
+#include <rpos/system/util/time_util.h>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+    // a 10 x 6 m room with a pillar, the robot drives a 1.5 m radius circle around its center
+    const double kRoomHalfX = 5.0;
+    const double kRoomHalfY = 3.0;
+    const double kPillarX = 2.0;
+    const double kPillarY = 1.0;
+    const double kPillarRadius = 0.3;
+    const double kTrajectoryRadius = 1.5;
+    const double kSpeed = 0.5;
+
+    const float kRangeMin = 0.15f;
+    const float kRangeMax = 25.f;
+    const float kRangeNoise = 0.01f;
+    const float kDropoutRatio = 0.01f;
+    const double kGyroBias = 0.002;
+
+    // marker ranges are kMarkerBaseRange + id * kMarkerStep
+    const float kMarkerBaseRange = 2.0f;
+    const float kMarkerStep = 0.001f;
+
+}
+
+namespace rp { namespace slamware { namespace utils {
+
+    LoadGenerator::LoadGenerator(ros::NodeHandle& nh, const Config& config)
+        : config_(config)
+        , startTime_(0)
+        , working_(false)
+    {
+        pubScan_ = nh.advertise<sensor_msgs::LaserScan>(config_.scanTopic, 1);
+        if (config_.accumulatedOdometry)
+            pubOdometry_ = nh.advertise<nav_msgs::Odometry>(config_.odometryTopic, 10);
+        else
+            pubOdometry_ = nh.advertise<geometry_msgs::Vector3Stamped>(config_.odometryTopic, 10);
+        if (!config_.imuTopic.empty())
+            pubImu_ = nh.advertise<sensor_msgs::Imu>(config_.imuTopic, 10);
+    }
+
+    LoadGenerator::~LoadGenerator()
+    {
+        stop();
+    }
+
+    void LoadGenerator::start(double scanRate, double odometryRate, double imuRate)
+    {
+        stop();
+        working_.store(true);
+        startTime_ = rpos::system::util::high_resolution_clock::get_time_in_us();
+
+        if (scanRate > 0)
+        {
+            workers_.push_back(std::thread([this, scanRate] {
+                sensor_msgs::LaserScan msg;
+                int id = 0;
+                streamThread_(scanRate, 1, [&](double t, const ros::Time& stamp, double, std::mt19937& rng) {
+                    msg.header.stamp = stamp;
+                    msg.scan_time = float(1.0 / scanRate);
+                    fillScan_(msg, t, id, rng);
+                    if (scanPublished_)
+                        scanPublished_(id, rpos::system::util::high_resolution_clock::get_time_in_us());
+                    pubScan_.publish(msg);
+                    id = (id + 1) % MarkerModulo;
+                });
+            }));
+        }
+        if (odometryRate > 0)
+        {
+            workers_.push_back(std::thread([this, odometryRate] {
+                nav_msgs::Odometry odometry;
+                geometry_msgs::Vector3Stamped deadreckon;
+                streamThread_(odometryRate, 2, [&](double t, const ros::Time& stamp, double dt, std::mt19937& rng) {
+                    if (config_.accumulatedOdometry)
+                    {
+                        odometry.header.stamp = stamp;
+                        fillOdometry_(odometry, t, rng);
+                        pubOdometry_.publish(odometry);
+                    }
+                    else
+                    {
+                        deadreckon.header.stamp = stamp;
+                        fillDeadReckon_(deadreckon, t, dt, rng);
+                        pubOdometry_.publish(deadreckon);
+                    }
+                });
+            }));
+        }
+        if (imuRate > 0 && !config_.imuTopic.empty())
+        {
+            workers_.push_back(std::thread([this, imuRate] {
+                sensor_msgs::Imu msg;
+                streamThread_(imuRate, 3, [&](double t, const ros::Time& stamp, double, std::mt19937& rng) {
+                    msg.header.stamp = stamp;
+                    fillImu_(msg, t, rng);
+                    pubImu_.publish(msg);
+                });
+            }));
+        }
+    }
+
+    void LoadGenerator::stop()
+    {
+        working_.store(false);
+        for (auto& worker : workers_)
+            worker.join();
+        workers_.clear();
+    }
+
+    float LoadGenerator::markerAngle() const
+    {
+        ScanGeometry geometry(float(-M_PI), float(2 * M_PI / config_.beams), config_.beams);
+        return rpos::core::rad2deg(geometry.radOf(config_.beams - 1));
+    }
+
+    float LoadGenerator::markerRange(int id)
+    {
+        return kMarkerBaseRange + (id % MarkerModulo) * kMarkerStep;
+    }
+
+    int LoadGenerator::markerId(float range)
+    {
+        int id = int(std::lround((range - kMarkerBaseRange) / kMarkerStep));
+        if (id < 0 || id >= MarkerModulo || std::fabs(range - markerRange(id)) > kMarkerStep / 4)
+            return -1;
+        return id;
+    }
+
+    template <typename FillT>
+    void LoadGenerator::streamThread_(double rate, int seed, FillT fill)
+    {
+        // samples are taken on the nominal grid and stamped with it, the publish is delayed by the jitter
+        std::mt19937 rng(seed);
+        std::normal_distribution<double> delay(0.0, config_.jitter);
+        const std::int64_t periodUs = std::max<std::int64_t>(std::int64_t(1000000 / rate), 1);
+        std::int64_t nominal = startTime_;
+        while (working_.load())
+        {
+            nominal += periodUs;
+            std::int64_t publishTime = nominal + std::int64_t(std::min(std::fabs(delay(rng)), 0.5) * periodUs);
+            std::int64_t now = rpos::system::util::high_resolution_clock::get_time_in_us();
+            if (publishTime > now)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(publishTime - now));
+                now = publishTime;
+            }
+            else if (now - nominal > 10 * periodUs)
+            {
+                // far behind the requested rate, skip ticks instead of bursting
+                nominal = now - periodUs;
+            }
+
+            ros::Time stamp = ros::Time::now() - ros::Duration((now - nominal) * 1e-6);
+            fill((nominal - startTime_) * 1e-6, stamp, periodUs * 1e-6, rng);
+        }
+    }
+
+    LoadGenerator::Pose LoadGenerator::poseAt_(double t) const
+    {
+        Pose pose;
+        pose.omega = kSpeed / kTrajectoryRadius;
+        pose.v = kSpeed;
+        pose.yaw = pose.omega * t;
+        pose.x = kTrajectoryRadius * std::sin(pose.yaw);
+        pose.y = -kTrajectoryRadius * std::cos(pose.yaw);
+        return pose;
+    }
+
+    float LoadGenerator::castRay_(double x, double y, double rad) const
+    {
+        const double dx = std::cos(rad);
+        const double dy = std::sin(rad);
+        double t = std::numeric_limits<double>::infinity();
+        if (dx > 0)
+            t = std::min(t, (kRoomHalfX - x) / dx);
+        else if (dx < 0)
+            t = std::min(t, (-kRoomHalfX - x) / dx);
+        if (dy > 0)
+            t = std::min(t, (kRoomHalfY - y) / dy);
+        else if (dy < 0)
+            t = std::min(t, (-kRoomHalfY - y) / dy);
+
+        const double ox = x - kPillarX;
+        const double oy = y - kPillarY;
+        const double b = ox * dx + oy * dy;
+        const double disc = b * b - (ox * ox + oy * oy - kPillarRadius * kPillarRadius);
+        if (disc >= 0)
+        {
+            double hit = -b - std::sqrt(disc);
+            if (hit > 0)
+                t = std::min(t, hit);
+        }
+        return float(t);
+    }
+
+    void LoadGenerator::fillScan_(sensor_msgs::LaserScan& msg, double t, int id, std::mt19937& rng)
+    {
+        std::normal_distribution<float> noise(0.f, kRangeNoise);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        msg.angle_min = float(-M_PI);
+        msg.angle_max = float(M_PI);
+        msg.angle_increment = float(2 * M_PI / config_.beams);
+        // a little short, so the beam count the bridge derives from scan_time is not truncated
+        msg.time_increment = msg.scan_time / (config_.beams + 0.5f);
+        msg.range_min = kRangeMin;
+        msg.range_max = kRangeMax;
+        msg.ranges.resize(config_.beams);
+
+        const Pose pose = poseAt_(t);
+        for (int i = 0; i < config_.beams; i++)
+        {
+            float range = castRay_(pose.x, pose.y, pose.yaw + msg.angle_min + msg.angle_increment * i) + noise(rng);
+            if (uniform(rng) < kDropoutRatio || range > kRangeMax)
+                range = std::numeric_limits<float>::infinity();
+            msg.ranges[i] = range;
+        }
+        if (config_.markScans)
+            msg.ranges.back() = markerRange(id);
+    }
+
+    void LoadGenerator::fillOdometry_(nav_msgs::Odometry& msg, double t, std::mt19937& rng)
+    {
+        std::normal_distribution<double> noise(0.0, 0.01);
+        const Pose pose = poseAt_(t);
+        msg.pose.pose.position.x = pose.x;
+        msg.pose.pose.position.y = pose.y;
+        msg.pose.pose.position.z = 0.0;
+        msg.pose.pose.orientation.x = 0.0;
+        msg.pose.pose.orientation.y = 0.0;
+        msg.pose.pose.orientation.z = std::sin(pose.yaw / 2);
+        msg.pose.pose.orientation.w = std::cos(pose.yaw / 2);
+        msg.twist.twist.linear.x = pose.v + noise(rng);
+        msg.twist.twist.linear.y = 0.0;
+        msg.twist.twist.angular.z = pose.omega + noise(rng);
+    }
+
+    void LoadGenerator::fillDeadReckon_(geometry_msgs::Vector3Stamped& msg, double t, double dt, std::mt19937& rng)
+    {
+        std::normal_distribution<double> noise(0.0, 0.0005);
+        const Pose from = poseAt_(t - dt);
+        const Pose to = poseAt_(t);
+        Se2Pose delta = Se2Pose(from.x, from.y, from.yaw).inverseTimes(Se2Pose(to.x, to.y, to.yaw));
+        msg.vector.x = delta.x() + noise(rng);
+        msg.vector.y = delta.y() + noise(rng);
+        msg.vector.z = delta.yaw() + noise(rng);
+    }
+
+    void LoadGenerator::fillImu_(sensor_msgs::Imu& msg, double t, std::mt19937& rng)
+    {
+        std::normal_distribution<double> gyroNoise(0.0, 0.005);
+        std::normal_distribution<double> accNoise(0.0, 0.05);
+        const Pose pose = poseAt_(t);
+        msg.orientation_covariance[0] = -1.0;     // no orientation estimate
+        msg.angular_velocity.x = gyroNoise(rng);
+        msg.angular_velocity.y = gyroNoise(rng);
+        msg.angular_velocity.z = pose.omega + kGyroBias + gyroNoise(rng);
+        // centripetal acceleration of the circle, towards its center on the left of the robot
+        msg.linear_acceleration.x = accNoise(rng);
+        msg.linear_acceleration.y = pose.v * pose.omega + accNoise(rng);
+        msg.linear_acceleration.z = 9.81 + accNoise(rng);
+    }
+
+}}}
@@ -0,0 +1,39 @@
+#include "odometry.h"
+#include <cmath>
+
+namespace rp { namespace slamware { namespace utils {
+
+    YawFusion::YawFusion(double timeConstant)
+        : timeConstant_(timeConstant)
+        , initialized_(false)
+        , preGyroYaw_(0.0)
+        , lastStepTime_(0)
+    {}
+
+    bool YawFusion::step(const Se2Pose& odom, double gyroYaw, std::int64_t now)
+    {
+        if (!initialized_)
+        {
+            initialized_ = true;
+            preOdom_ = odom;
+            fused_ = odom;
+            preGyroYaw_ = gyroYaw;
+            lastStepTime_ = now;
+            return false;
+        }
+
+        Se2Pose odomDelta = preOdom_.inverseTimes(odom);
+        double gyroDyaw = gyroYaw - preGyroYaw_;
+        double dt = (now - lastStepTime_) * 1e-6;
+        double gain = dt / (timeConstant_ + dt);
+        double predictedYaw = fused_.yaw() + gyroDyaw;
+        double correction = gain * std::atan2(std::sin(odom.yaw() - predictedYaw), std::cos(odom.yaw() - predictedYaw));
+        fused_ = fused_ * Se2Pose(odomDelta.x(), odomDelta.y(), gyroDyaw + correction);
+
+        preOdom_ = odom;
+        preGyroYaw_ = gyroYaw;
+        lastStepTime_ = now;
+        return true;
+    }
+
+}}}
@@ -0,0 +1,89 @@
+#include "reflex_guard.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rp { namespace slamware { namespace utils {
+
+    namespace {
+        const float kTwoPi = float(2 * M_PI);
+        const float kSectorRad = kTwoPi / ReflexGuard::SectorCount;
+    }
+
+    ReflexGuard::ReflexGuard()
+    {
+        config_.robotRadius = 0.2f;
+        config_.stopMargin = 0.05f;
+        config_.deceleration = 1.0f;
+        config_.reactionTime = 0.1f;
+        config_.scanTimeout = 500000;
+        config_.laserYaw = 0.f;
+
+        for (int i = 0; i < SectorCount; i++)
+        {
+            float rad = (i + 0.5f) * kSectorRad;
+            sectorCos_[i] = std::cos(rad);
+            sectorSin_[i] = std::sin(rad);
+        }
+        beginScan();
+        building_.timestamp = 0;
+    }
+
+    void ReflexGuard::beginScan()
+    {
+        std::fill(building_.minRange, building_.minRange + SectorCount, std::numeric_limits<float>::infinity());
+    }
+
+    void ReflexGuard::addPoint(float rad, float dist)
+    {
+        float baseRad = rad + config_.laserYaw;
+        baseRad -= kTwoPi * std::floor(baseRad / kTwoPi);
+        int sector = std::min(std::max(int(baseRad / kSectorRad), 0), SectorCount - 1);
+        if (dist < building_.minRange[sector])
+            building_.minRange[sector] = dist;
+    }
+
+    void ReflexGuard::commitScan(std::int64_t timestamp)
+    {
+        building_.timestamp = timestamp;
+        sectors_.store(building_);
+    }
+
+    float ReflexGuard::speedScale(float vx, float vy, std::int64_t now) const
+    {
+        float speed = std::sqrt(vx * vx + vy * vy);
+        if (speed < 1e-3f)
+            return 1.f;
+
+        Sectors sectors;
+        if (!sectors_.load(sectors) || now - sectors.timestamp > config_.scanTimeout)
+            return 1.f;
+
+        // free distance along the direction of motion inside the corridor swept by the robot
+        float dirX = vx / speed;
+        float dirY = vy / speed;
+        float freeDist = std::numeric_limits<float>::infinity();
+        for (int i = 0; i < SectorCount; i++)
+        {
+            float range = sectors.minRange[i];
+            if (!(range < freeDist + config_.robotRadius))
+                continue;
+            float longitudinal = range * (sectorCos_[i] * dirX + sectorSin_[i] * dirY);
+            float lateral = range * (sectorSin_[i] * dirX - sectorCos_[i] * dirY);
+            if (longitudinal <= 0.f || std::fabs(lateral) > config_.robotRadius)
+                continue;
+            freeDist = std::min(freeDist, longitudinal - config_.robotRadius);
+        }
+
+        float available = freeDist - config_.stopMargin;
+        if (available <= 0.f)
+            return 0.f;
+
+        // largest v with v * t + v^2 / (2 * a) <= available
+        float a = config_.deceleration;
+        float t = config_.reactionTime;
+        float allowed = -a * t + std::sqrt(a * a * t * t + 2 * a * available);
+        return std::min(1.f, allowed / speed);
+    }
+
+}}}
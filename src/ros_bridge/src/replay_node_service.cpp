@@ -0,0 +1,261 @@
+#include "replay_node_service.h"
+#include "session_recorder.h"
+#include <rpos/message/diagnosis/lidar_messages_serialization.h>
+#include <rpos/message/diagnosis/base_messages_serialization.h>
+#include <rpos/system/util/time_util.h>
+#include <chrono>
+#include <functional>
+
+namespace {
+
+    std::int64_t nowUs()
+    {
+        return rpos::system::util::high_resolution_clock::get_time_in_us();
+    }
+
+}
+
+namespace rp { namespace slamware { namespace utils {
+
+    ReplayNodeService::ReplayNodeService(const Options& options)
+        : options_(options)
+        , working_(false)
+        , finished_(false)
+        , estimationTimestamp_(0)
+        , scans_(0)
+        , estimations_(0)
+        , recordedMotions_(0)
+        , liveMotions_(0)
+        , recordedDuration_(0)
+        , replayDuration_(0)
+    {
+        provides<IRosNode>();
+        // no imu device, the recording does not carry imu data
+        config_.imu_sub_topic.clear();
+    }
+
+    ReplayNodeService::~ReplayNodeService()
+    {
+    }
+
+    bool ReplayNodeService::onStart()
+    {
+        if (!reader_.open(options_.directory))
+        {
+            logger.error_out("can not open recording %s", options_.directory.c_str());
+            return false;
+        }
+        if (options_.rate > 0)
+            logger.info_out("replay %s at %.1fx", options_.directory.c_str(), options_.rate);
+        else
+            logger.info_out("replay %s as fast as possible", options_.directory.c_str());
+
+        working_ = true;
+        finished_ = false;
+        replayWorker_ = std::thread(std::bind(&ReplayNodeService::replayThread_, this));
+        return true;
+    }
+
+    bool ReplayNodeService::onStop()
+    {
+        {
+            std::lock_guard<std::mutex> lkGuard(lock_);
+            working_ = false;
+        }
+        signal_.notify_all();
+        if (replayWorker_.joinable())
+            replayWorker_.join();
+        reader_.close();
+        return true;
+    }
+
+    void ReplayNodeService::spin()
+    {
+        std::unique_lock<std::mutex> lk(lock_);
+        signal_.wait(lk, [this] { return finished_; });
+    }
+
+    bool ReplayNodeService::getLaserScan(rpos::message::lidar::LidarScan&)
+    {
+        // scans are pushed to the lidar device
+        return false;
+    }
+
+    void ReplayNodeService::publishMotion(const rpos::message::base::MotionRequest&)
+    {
+        liveMotions_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void ReplayNodeService::getMovementEstimation(rpos::message::Message<rpos::message::base::MovementEstimation>& estimation)
+    {
+        std::lock_guard<std::mutex> lkGuard(estimationLock_);
+        estimation->positionDifference.x() = float(pendingEstimation_.x());
+        estimation->positionDifference.y() = float(pendingEstimation_.y());
+        estimation->angularDifference = float(pendingEstimation_.yaw());
+        estimation.timestamp = estimationTimestamp_ / 1000;     // the sdk message timestamp is in ms
+        pendingEstimation_ = Se2Pose();
+    }
+
+    void ReplayNodeService::getImuAllSensorData(rpos::message::imu::ImuAllSensorData&)
+    {
+    }
+
+    void ReplayNodeService::getExtendedSensorData(std::vector<PseudoBaseDevice::BaseSensorData>& extendedSensorData)
+    {
+        extendedSensorData.clear();
+    }
+
+    void ReplayNodeService::getBaseStatus(PseudoBaseDevice::BaseStatusData& data)
+    {
+        data.isDockLocked = false;
+        data.isCharging = false;
+        data.battery_percentage = 100;
+    }
+
+    void ReplayNodeService::registerLidarDevice(boost::shared_ptr<PseudoRPLidarDevice> lidarDevice)
+    {
+        {
+            std::lock_guard<std::mutex> lkGuard(lock_);
+            lidarDevice_ = lidarDevice;
+        }
+        signal_.notify_all();
+    }
+
+    void ReplayNodeService::registerBaseDevice(boost::shared_ptr<PseudoBaseDevice> baseDevice)
+    {
+        {
+            std::lock_guard<std::mutex> lkGuard(lock_);
+            baseDevice_ = baseDevice;
+        }
+        signal_.notify_all();
+    }
+
+    void ReplayNodeService::reportStats()
+    {
+        Summary s = summary();
+        logger.info_out("replay: %.1f s of recording in %.1f s, scans %llu, estimations %llu, motion requests %llu recorded, %llu live",
+            s.recordedDuration * 1e-6, s.replayDuration * 1e-6,
+            (unsigned long long)s.scans, (unsigned long long)s.estimations, (unsigned long long)s.recordedMotions, (unsigned long long)s.liveMotions);
+    }
+
+    void ReplayNodeService::sleepFor(std::int64_t us)
+    {
+        // slamware runs on the host clock whatever the replay rate, so does the heartbeat
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+
+    ReplayNodeService::Summary ReplayNodeService::summary() const
+    {
+        Summary s;
+        s.scans = scans_.load(std::memory_order_relaxed);
+        s.estimations = estimations_.load(std::memory_order_relaxed);
+        s.recordedMotions = recordedMotions_.load(std::memory_order_relaxed);
+        s.liveMotions = liveMotions_.load(std::memory_order_relaxed);
+        s.recordedDuration = recordedDuration_.load(std::memory_order_relaxed);
+        s.replayDuration = replayDuration_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    bool ReplayNodeService::waitUntil_(std::int64_t steadyTime)
+    {
+        std::unique_lock<std::mutex> lk(lock_);
+        while (working_)
+        {
+            std::int64_t now = nowUs();
+            if (now >= steadyTime)
+                return true;
+            signal_.wait_for(lk, std::chrono::microseconds(steadyTime - now));
+        }
+        return false;
+    }
+
+    void ReplayNodeService::replayThread_()
+    {
+        {
+            std::unique_lock<std::mutex> lk(lock_);
+            signal_.wait(lk, [this] { return !working_ || (lidarDevice_ && baseDevice_); });
+        }
+        if (waitUntil_(nowUs() + std::int64_t(options_.startDelay * 1e6)))
+        {
+            SessionReadStream& messages = *reader_.messages();
+            rpos::message::Message<rpos::message::lidar::LidarScan> scan;
+            rpos::message::Message<std::vector<std::uint8_t> > compactScan;
+            ScanDecoder scanDecoder;
+            std::uint64_t undecodedScans = 0;
+            rpos::message::Message<rpos::message::base::MovementEstimation> estimation;
+            rpos::message::Message<rpos::message::base::MotionRequest> motion;
+
+            // messages are delivered one by one in recorded order, only their pacing depends on the rate
+            const std::int64_t replayStart = nowUs();
+            std::int64_t recordStart = -1;
+            while (messages.hasNextMessage())
+            {
+                // older recordings hold estimations stamped 0 before the first odometry, they are
+                // delivered at once and neither start nor pace the replay
+                const std::int64_t recordTime = std::int64_t(messages.nextMessageTimestamp());
+                const bool stamped = recordTime > 0;
+                if (recordStart < 0 && stamped)
+                    recordStart = recordTime;
+                std::int64_t replayTime = nowUs();
+                if (options_.rate > 0 && stamped)
+                    replayTime = replayStart + std::int64_t((recordTime - recordStart) / options_.rate);
+                if (!waitUntil_(replayTime))
+                    break;
+
+                const std::string& topic = messages.nextMessageTopic();
+                if (topic == SessionRecorder::ScanTopic)
+                {
+                    messages.read(scan);
+                    lidarDevice_->onScanDataReceived(std::move(scan.payload));
+                    scans_.fetch_add(1, std::memory_order_relaxed);
+                }
+                else if (topic == SessionRecorder::CompactScanTopic)
+                {
+                    messages.read(compactScan);
+                    if (scanDecoder.decode(compactScan.payload, scan.payload))
+                    {
+                        lidarDevice_->onScanDataReceived(std::move(scan.payload));
+                        scans_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        undecodedScans++;
+                    }
+                }
+                else if (topic == SessionRecorder::MovementEstimationTopic)
+                {
+                    messages.read(estimation);
+                    std::lock_guard<std::mutex> lkGuard(estimationLock_);
+                    pendingEstimation_ = pendingEstimation_ * Se2Pose(estimation->positionDifference.x(),
+                        estimation->positionDifference.y(), estimation->angularDifference);
+                    estimationTimestamp_ = replayTime;
+                    estimations_.fetch_add(1, std::memory_order_relaxed);
+                }
+                else if (topic == SessionRecorder::MotionRequestTopic)
+                {
+                    messages.read(motion);
+                    recordedMotions_.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    messages.skip();
+                }
+                if (stamped)
+                    recordedDuration_.store(recordTime - recordStart, std::memory_order_relaxed);
+                replayDuration_.store(nowUs() - replayStart, std::memory_order_relaxed);
+            }
+            if (messages.skippedBytes())
+                logger.warn_out("skipped %llu bytes of cut or corrupted frames", (unsigned long long)messages.skippedBytes());
+            if (undecodedScans)
+                logger.warn_out("skipped %llu compact scans waiting for a keyframe", (unsigned long long)undecodedScans);
+        }
+
+        logger.info_out("replay finished");
+        {
+            std::lock_guard<std::mutex> lkGuard(lock_);
+            finished_ = true;
+        }
+        signal_.notify_all();
+    }
+
+}}}
@@ -1,21 +1,61 @@
 #include "ros1_node.h"
+#include "trace_probes.h"
 #include <rpos/core/angle_math.h>
 #include <rpos/system/util/time_util.h>
-#include <tf2/LinearMath/Quaternion.h>
-#include <tf2/LinearMath/Matrix3x3.h>
-#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+
+namespace {
+
+    // offset samples further than this from the filtered offset are taken as a clock step (ns)
+    const std::int64_t kClockStepThreshold = 50000000;
+    const double kClockOffsetFilterGain = 0.1;
+
+    // a motion request is probed only if it differs from the current odometry velocity by this much (m/s, rad/s)
+    const float kActuationMinStep = 0.02f;
+    // the base is considered responding once its velocity covered this ratio of the commanded step
+    const float kActuationProgressRatio = 0.2f;
+    const std::int64_t kActuationTimeoutUs = 1000000;
+
+}
 
 namespace rp { namespace slamware { namespace utils {
 
     using namespace rpos::system::shared_memory;
 
-    Ros1Node::Ros1Node(int argc, char** argv, const std::string& nodeName) 
+    Ros1Node::Ros1Node(int argc, char** argv, const std::string& nodeName, bool offline)
         : Ros1NodeBase(argc, argv, nodeName)
-        , initEstimationFlag_(true)
         , isOdometry_(true)
         , enable_shared_memory_(false)
+        , rangeSensorCount_(0)
+        , rangeTimeout_(500)
+        , actuationProbeActive_(false)
+        , actuationTimeouts_(0)
+        , reflexStopEnabled_(false)
+        , imuFusionEnabled_(false)
+        , imuFusionTimeConstant_(2.0)
+        , fusionWorking_(false)
+        , timeOffset_(0)
+        , startupTimeOffset_(0)
+        , timeOffsetSteps_(0)
+        , clockSyncInterval_(1.0)
+        , clockWorking_(false)
+        , simTimeEnabled_(false)
+        , simClockUs_(0)
+        , recorder_(nullptr)
     {
+        gyroIntegral_[0] = gyroIntegral_[1] = gyroIntegral_[2] = 0.0;
+        // a node handle starts the node, which blocks until a ros master is reachable
+        if (!offline)
+            nh_.reset(new ros::NodeHandle());
+
+        baseStatus_.isDockLocked = false;
+        baseStatus_.isCharging = false;
+        baseStatus_.battery_percentage = 100;
+        baseStatusSnapshot_.store(baseStatus_);
         generateTimeOffset_();
     }
 
@@ -28,32 +68,137 @@ namespace rp { namespace slamware { namespace utils {
 	{
 		subLaserScan_ = ros::Subscriber();
         subOdometry_ = ros::Subscriber();
+        subImu_ = ros::Subscriber();
+        subRanges_.clear();
+        subBattery_ = ros::Subscriber();
+        subDock_ = ros::Subscriber();
+        subClock_ = ros::Subscriber();
+        srvDumpFlightRecorder_.shutdown();
+        stopFusion_();
+        stopClockSync_();
 	}
     
     void Ros1Node::initConfig(RosNodeConfig& cfg)
     {
-        cfg.setBy(nh_);
+        if (nh_)
+            cfg.setBy(*nh_);
         enable_shared_memory_ = cfg.enable_shared_memory_lidar;
+        scanConverter_.setEchoSelection(cfg.echo_selection);
+        rangeTimeout_ = std::int64_t(cfg.range_timeout * 1000);
+        imuFusionEnabled_ = cfg.enable_imu_fusion;
+        imuFusionTimeConstant_ = cfg.imu_fusion_time_constant;
+
+        clockSyncInterval_ = cfg.clock_sync_interval;
+        simTimeEnabled_ = cfg.use_sim_time;
+        if (simTimeEnabled_)
+        {
+            // stamps pass through unchanged, so replayed data keeps its recorded spacing at any rate
+            startupTimeOffset_ = 0;
+            timeOffset_.store(0);
+            subClock_ = subscribe_("/clock", 10, &Ros1Node::clockCallback_);
+            ROS_INFO("use sim time, the bridge follows /clock");
+        }
+        else if (clockSyncInterval_ > 0 && !clockWorker_.joinable())
+        {
+            clockWorking_ = true;
+            clockWorker_ = std::thread(std::bind(&Ros1Node::clockThread_, this));
+        }
+
+        reflexStopEnabled_ = cfg.reflex_stop_enabled;
+        ReflexGuard::Config reflexConfig;
+        reflexConfig.robotRadius = cfg.reflex_robot_radius;
+        reflexConfig.stopMargin = cfg.reflex_stop_margin;
+        reflexConfig.deceleration = cfg.reflex_deceleration;
+        reflexConfig.reactionTime = cfg.reflex_reaction_time;
+        reflexConfig.scanTimeout = std::int64_t(cfg.reflex_scan_timeout * 1e6);
+        reflexConfig.laserYaw = cfg.reflex_laser_yaw;
+        reflexGuard_.configure(reflexConfig);
+        scanConverter_.setReflexGuard(reflexStopEnabled_ ? &reflexGuard_ : nullptr);
     }
     
+    void Ros1Node::setRecorder(SessionRecorder* recorder)
+    {
+        recorder_ = recorder;
+        if (recorder_ && recorder_->isFlightRecording() && nh_)
+        {
+            srvDumpFlightRecorder_ = nh_->advertiseService("dump_flight_recorder", &Ros1Node::dumpFlightRecorder_, this);
+            ROS_INFO("advertise dump_flight_recorder service");
+        }
+    }
+
+    bool Ros1Node::dumpFlightRecorder_(std_srvs::Trigger::Request&, std_srvs::Trigger::Response& response)
+    {
+        response.success = recorder_ && recorder_->requestDump("service");
+        response.message = response.success ? "dump requested" : "flight recorder disabled";
+        return true;
+    }
+
     void Ros1Node::subscribe(std::string& msgTopic, std::uint32_t queueSize, MsgType msgType)
     {
         if (msgType == MsgTypeScan)
         {
-            subLaserScan_ = nh_.subscribe(msgTopic, queueSize, &Ros1Node::laserScanCallback_, this);
+            subLaserScan_ = subscribe_(msgTopic, queueSize, &Ros1Node::laserScanCallback_);
+            if (nh_)
+                nh_->setParam("~scan_angle_ordered", true);
+            ROS_INFO("subscribe scan topic: %s, scan output is in increasing angle order", msgTopic.c_str());
+        }
+        else if (msgType == MsgTypeMultiEchoScan)
+        {
+            subLaserScan_ = subscribe_(msgTopic, queueSize, &Ros1Node::multiEchoScanCallback_);
+            if (nh_)
+                nh_->setParam("~scan_angle_ordered", true);
+            ROS_INFO("subscribe multi echo scan topic: %s, echo selection: %d", msgTopic.c_str(), (int)scanConverter_.echoSelection());
         }
         else if (msgType == MsgTypeOdometry)
         {  
-            subOdometry_ = nh_.subscribe(msgTopic, queueSize, &Ros1Node::odometryCallback_, this);
+            subOdometry_ = subscribe_(msgTopic, queueSize, &Ros1Node::odometryCallback_);
             isOdometry_ = true;
             ROS_INFO("subscribe odometry topic: %s", msgTopic.c_str());
         }
         else if ( msgType == MsgTypeDeadreckon)
         {
-            subOdometry_ = nh_.subscribe(msgTopic, queueSize, &Ros1Node::deadReckonCallback_, this);
+            subOdometry_ = subscribe_(msgTopic, queueSize, &Ros1Node::deadReckonCallback_);
             isOdometry_ = false;
             ROS_INFO("subscribe deadreckon topic: %s", msgTopic.c_str());
         }
+        else if (msgType == MsgTypeImu)
+        {
+            subImu_ = subscribe_(msgTopic, queueSize, &Ros1Node::imuCallback_);
+            ROS_INFO("subscribe imu topic: %s", msgTopic.c_str());
+            if (imuFusionEnabled_ && !isOdometry_)
+            {
+                ROS_WARN("imu fusion needs accumulated odometry, fusion disabled");
+                imuFusionEnabled_ = false;
+            }
+            if (imuFusionEnabled_ && !fusionWorking_.load())
+            {
+                fusionWorking_.store(true);
+                fusionWorker_ = std::thread(std::bind(&Ros1Node::fusionThread_, this));
+            }
+        }
+        else if (msgType == MsgTypeRange)
+        {
+            int sensorId = rangeSensorCount_.load();
+            if (sensorId >= MaxRangeSensors)
+            {
+                ROS_WARN("too many range topics, ignore %s", msgTopic.c_str());
+                return;
+            }
+            if (nh_)
+                subRanges_.push_back(nh_->subscribe<sensor_msgs::Range>(msgTopic, queueSize, boost::bind(&Ros1Node::rangeCallback_, this, _1, sensorId)));
+            rangeSensorCount_.store(sensorId + 1);
+            ROS_INFO("subscribe range topic: %s, sensor id: %d", msgTopic.c_str(), sensorId);
+        }
+        else if (msgType == MsgTypeBattery)
+        {
+            subBattery_ = subscribe_(msgTopic, queueSize, &Ros1Node::batteryCallback_);
+            ROS_INFO("subscribe battery topic: %s", msgTopic.c_str());
+        }
+        else if (msgType == MsgTypeDock)
+        {
+            subDock_ = subscribe_(msgTopic, queueSize, &Ros1Node::dockCallback_);
+            ROS_INFO("subscribe dock topic: %s", msgTopic.c_str());
+        }
     }
 
     void Ros1Node::spin(bool isOnce)
@@ -72,60 +217,266 @@ namespace rp { namespace slamware { namespace utils {
 
     rpos::core::Vector3f Ros1Node::getDeadReckon(uint64_t& timestamp)
     {
+        BRIDGE_TRACE(dead_reckon_begin);
         double dx = 0.0;
         double dy = 0.0;
         double dyaw = 0.0;
         if(isOdometry_)
         {
-            if (initEstimationFlag_)
+            Se2Pose pose;
+            if (imuFusionEnabled_)
             {
-                std::lock_guard<std::mutex> lkGuard(poseDataLock_);
-                initEstimationFlag_ = false;
-                prePose_ = pose_;
-                timestamp = odomTimestamp_;
+                FusedPose fused;
+                if (!fusedPose_.load(fused))
+                {
+                    timestamp = 0;
+                    BRIDGE_TRACE1(dead_reckon_end, timestamp);
+                    return rpos::core::Vector3f(0.f, 0.f, 0.f);
+                }
+                pose = Se2Pose(fused.x, fused.y, fused.yaw);
+                timestamp = fused.timestamp;
             }
             else
             {
-                std::lock_guard<std::mutex> lkGuard(poseDataLock_);
-                tf2::Transform trans = prePose_.inverseTimes(pose_);
-                dx = trans.getOrigin().getX();
-                dy = trans.getOrigin().getY();
-                double roll, pitch;
-                trans.getBasis().getRPY(roll, pitch, dyaw);
-                timestamp = odomTimestamp_;
-                prePose_ = pose_;
+                // the raw odometry is only decoded here, at the fetch rate of slamware
+                RawOdometry raw;
+                if (!rawOdometry_.load(raw))
+                {
+                    timestamp = 0;
+                    BRIDGE_TRACE1(dead_reckon_end, timestamp);
+                    return rpos::core::Vector3f(0.f, 0.f, 0.f);
+                }
+
+                pose = Se2Pose::fromQuaternion(raw.position[0], raw.position[1],
+                    raw.orientation[0], raw.orientation[1], raw.orientation[2], raw.orientation[3]);
+                timestamp = raw.timestamp;
             }
+            Se2Pose delta = poseDelta_.next(pose);
+            dx = delta.x();
+            dy = delta.y();
+            dyaw = delta.yaw();
         }
         else
         {
-            std::vector<rpos::core::Vector3f> deadreckons;
+            // swap the filled buffers out, the producer keeps appending into the emptied ones without reallocating
             {
                 std::lock_guard<std::mutex> lkGuard(poseDataLock_);
-                deadreckons.swap(deadreckon_);
+                deadreckonFetched_.swap(deadreckon_);
                 timestamp = odomTimestamp_;
             }
-            for(auto odom : deadreckons)
-            { 
-                double costheta = cos(dyaw);
-                double sinTheta = sin(dyaw);
-                dx += odom.x() * costheta - odom.y()* sinTheta;
-                dy += odom.x() * sinTheta + odom.y()* costheta;
-                dyaw += odom.z();
-            }
+            Se2Pose delta = deadreckonFetched_.integrate(deadreckonHeadings_);
+            deadreckonFetched_.clear();
+            dx = delta.x();
+            dy = delta.y();
+            dyaw = delta.yaw();
         } 
         dyaw = rpos::core::constraitRadNegativePiToPi(dyaw);
 
+        BRIDGE_TRACE1(dead_reckon_end, timestamp);
         return rpos::core::Vector3f(dx,dy,dyaw);
     }
 
+    void Ros1Node::getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData)
+    {
+        ImuSample sample;
+        imuSample_.load(sample);
+        sensorData.acc = rpos::core::Vector3f(sample.acc[0], sample.acc[1], sample.acc[2]);
+        sensorData.gyro = rpos::core::Vector3f(sample.gyro[0], sample.gyro[1], sample.gyro[2]);
+        // the SDK only takes float, the integral is narrowed here and nowhere else
+        sensorData.gyroIntegral = rpos::core::Vector3f(float(sample.gyroIntegral[0]), float(sample.gyroIntegral[1]), float(sample.gyroIntegral[2]));
+        sensorData.compass = rpos::core::Vector3f(0.f, 0.f, 0.f);
+    }
+
+    void Ros1Node::getExtendedSensorData(std::vector<PseudoBaseDevice::BaseSensorData>& extendedSensorData)
+    {
+        const int count = rangeSensorCount_.load();
+        const std::int64_t now = rpos::system::util::high_resolution_clock::get_time_in_ms();
+        extendedSensorData.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            RangeSample sample;
+            rangeSamples_[i].load(sample);
+            extendedSensorData[i].rawDist = sample.dist;
+            extendedSensorData[i].valid = sample.valid && (now - sample.receivedTime) <= rangeTimeout_;
+        }
+    }
+
+    void Ros1Node::getBaseStatus(PseudoBaseDevice::BaseStatusData& data)
+    {
+        baseStatusSnapshot_.load(data);
+    }
+
+    void Ros1Node::onMotionRequest(const rpos::message::base::MotionRequest& request)
+    {
+        if (!isOdometry_)
+            return;
+
+        // without odometry the probe is never checked, it times out here instead
+        const std::int64_t now = rpos::system::util::high_resolution_clock::get_time_in_us();
+        if (actuationProbeActive_.load(std::memory_order_acquire))
+        {
+            ActuationProbe active;
+            std::uint32_t sequence = actuationProbe_.load(active);
+            if (now - active.requestTime <= kActuationTimeoutUs)
+                return;
+            if (endActuationProbe_(sequence))
+                actuationTimeouts_.fetch_add(1, std::memory_order_relaxed);
+            else if (actuationProbeActive_.load(std::memory_order_acquire))
+                return;
+        }
+
+        BaseVelocity velocity;
+        if (!odomVelocity_.load(velocity))
+            return;
+
+        ActuationProbe probe;
+        probe.command[0] = request.vx();
+        probe.command[1] = request.vy();
+        probe.command[2] = request.omega();
+        float step = 0.f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            probe.baseline[axis] = velocity.v[axis];
+            step = std::max(step, std::fabs(probe.command[axis] - probe.baseline[axis]));
+        }
+        if (step < kActuationMinStep)
+            return;
+
+        probe.requestTime = now;
+        actuationProbe_.store(probe);
+        actuationProbeActive_.store(true, std::memory_order_release);
+    }
+
+    bool Ros1Node::guardMotion(rpos::message::base::MotionRequest& request) const
+    {
+        if (!reflexStopEnabled_)
+            return false;
+
+        float scale = reflexGuard_.speedScale(request.vx(), request.vy(), rpos::system::util::high_resolution_clock::get_time_in_us());
+        if (scale >= 1.f)
+            return false;
+
+        request.vx() *= scale;
+        request.vy() *= scale;
+        return true;
+    }
+
+    ros::Time Ros1Node::rosTimeOf(std::int64_t steadyTimeUs) const
+    {
+        ros::Time stamp;
+        if (simTimeEnabled_)
+        {
+            // a steady clock age does not map onto /clock unless it runs at 1x, stamp with the
+            // current sim time instead, offline there is no ros time but the last /clock seen
+            if (nh_)
+                return ros::Time::now();
+            stamp.fromNSec(simClockUs_.load(std::memory_order_relaxed) * 1000);
+            return stamp;
+        }
+        stamp.fromNSec(steadyTimeUs * 1000 + timeOffset_.load(std::memory_order_relaxed));
+        return stamp;
+    }
+
+    void Ros1Node::sleepFor(std::int64_t us)
+    {
+        if (!simTimeEnabled_)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(us));
+            return;
+        }
+
+        // wake up once /clock has advanced by us, but never later than us of steady time,
+        // so a paused or slow replay still keeps the bridge alive
+        std::unique_lock<std::mutex> lk(simClockLock_);
+        const std::int64_t until = simClockUs_.load() + us;
+        simClockSignal_.wait_for(lk, std::chrono::microseconds(us), [this, until] { return simClockUs_.load() >= until; });
+    }
+
+    std::int64_t Ros1Node::takeClockDrift(std::uint64_t& steps)
+    {
+        steps = timeOffsetSteps_.exchange(0, std::memory_order_relaxed);
+        return (timeOffset_.load(std::memory_order_relaxed) - startupTimeOffset_) / 1000;
+    }
+
+    LatencyStat::Summary Ros1Node::takeOdometryCallbackCost()
+    {
+        return odometryCallbackCost_.takeSummary();
+    }
+
+    LatencyHistogram::Summary Ros1Node::takeActuationLatency(std::uint64_t& timeouts)
+    {
+        timeouts = actuationTimeouts_.exchange(0, std::memory_order_relaxed);
+        return actuationLatency_.takeSummary();
+    }
+
+    void Ros1Node::checkActuation_(const float (&velocity)[3], std::int64_t receivedTime)
+    {
+        ActuationProbe probe;
+        std::uint32_t sequence = actuationProbe_.load(probe);
+        std::int64_t latency = receivedTime - probe.requestTime;
+        if (latency > kActuationTimeoutUs)
+        {
+            if (endActuationProbe_(sequence))
+                actuationTimeouts_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // progress of the odometry velocity along the commanded step
+        float along = 0.f;
+        float step2 = 0.f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float step = probe.command[axis] - probe.baseline[axis];
+            along += (velocity[axis] - probe.baseline[axis]) * step;
+            step2 += step * step;
+        }
+        if (along >= kActuationProgressRatio * step2 && endActuationProbe_(sequence))
+            actuationLatency_.push(latency);
+    }
+
+    bool Ros1Node::endActuationProbe_(std::uint32_t sequence)
+    {
+        // the odometry callback and onMotionRequest may both end the probe, only one of them counts it
+        bool active = true;
+        return actuationProbe_.sequence() == sequence
+            && actuationProbeActive_.compare_exchange_strong(active, false, std::memory_order_acq_rel);
+    }
+
     void Ros1Node::laserScanCallback_(const sensor_msgs::LaserScan::ConstPtr& msg)
     {
-        int count = msg->scan_time / msg->time_increment; 
+        convertScan_(*msg, msg->ranges.size(), [&](const ScanLayout& layout, rpos::message::lidar::LidarScan& laserScan, bool sharedMemoryEnabled) {
+            if (sharedMemoryEnabled)
+                scanConverter_.convert(layout, msg->ranges.data(), laserScan, ShmPointWriter(laserScanMsg_->payload));
+            else
+                scanConverter_.convert(layout, msg->ranges.data(), laserScan);
+        });
+    }
+
+    void Ros1Node::multiEchoScanCallback_(const sensor_msgs::MultiEchoLaserScan::ConstPtr& msg)
+    {
+        auto echoesOf = [&](int beam) -> const std::vector<float>& {
+            return msg->ranges[beam].echoes;
+        };
+        auto intensitiesOf = [&](int beam) -> const std::vector<float>* {
+            return beam < (int)msg->intensities.size() ? &msg->intensities[beam].echoes : nullptr;
+        };
+        convertScan_(*msg, msg->ranges.size(), [&](const ScanLayout& layout, rpos::message::lidar::LidarScan& laserScan, bool sharedMemoryEnabled) {
+            if (sharedMemoryEnabled)
+                scanConverter_.convertMultiEcho(layout, echoesOf, intensitiesOf, laserScan, ShmPointWriter(laserScanMsg_->payload));
+            else
+                scanConverter_.convertMultiEcho(layout, echoesOf, intensitiesOf, laserScan, ScanConverter::NoPointHandler());
+        });
+    }
+
+    template <typename ScanMsgT, typename ConverterT>
+    void Ros1Node::convertScan_(const ScanMsgT& msg, size_t beamCount, ConverterT convert)
+    {
+        BRIDGE_TRACE1(scan_begin, beamCount);
+        int count = msg.scan_time / msg.time_increment; 
 
-        count = std::min<int>(count, msg->ranges.size());
+        count = std::min<int>(count, beamCount);
         
-        auto duration = msg->header.stamp - startupSystemTime_; 
-        int64_t ts = startupSteadyTime_ + duration.sec*1000 + duration.nsec/1000000;
+        std::int64_t ts = steadyTimeUsOf_(msg.header.stamp);
 
         rpos::message::lidar::LidarScan laserScan; 
 
@@ -133,62 +484,251 @@ namespace rp { namespace slamware { namespace utils {
         if(sharedMemoryEnabled)
         {
             laserScanMsg_->payload.data.clear();
-            laserScanMsg_->timestamp = ts;
-        }
-        for (int i = 0; i < count; i++)
-        {
-            if (msg->ranges[i] < msg->range_min || msg->ranges[i] > msg->range_max)
-                continue;
-
-            float degree = msg->angle_min + msg->angle_increment * i;
-            float rad = rpos::core::constraitRadZeroTo2Pi(degree + M_PI); //RPlidar ROS SDK inverse all the data
-
-            rpos::message::lidar::LidarScanPoint lidarPoint;
-            lidarPoint.dist = msg->ranges[i];
-            lidarPoint.angle = rpos::core::rad2deg(rad);
-            lidarPoint.valid = true;
-	        lidarPoint.layer = "";
-            laserScan.push_back(lidarPoint);
-
-            if(sharedMemoryEnabled)
-            {
-                rpos::system::shared_memory::LaserPoint p;
-                p.angle = rad;
-                p.dist = lidarPoint.dist;
-                p.valid = lidarPoint.valid;
-                laserScanMsg_->payload.data.push_back(p);
-            }
+            laserScanMsg_->timestamp = ts / 1000;
         }
+        ScanLayout layout;
+        layout.angleMin = msg.angle_min;
+        layout.angleIncrement = msg.angle_increment;
+        layout.rangeMin = msg.range_min;
+        layout.rangeMax = msg.range_max;
+        layout.count = count;
+        convert(layout, laserScan, sharedMemoryEnabled);
+        BRIDGE_TRACE2(scan_converted, ts, laserScan.size());
+        if (recorder_)
+            recorder_->recordScan(laserScan, ts);
         lidarDevice_->onScanDataReceived(std::move(laserScan)); 
+        BRIDGE_TRACE1(scan_delivered, ts);
         if(topicLaserScan_)
+        {
             topicLaserScan_->publish(*laserScanMsg_);
+            BRIDGE_TRACE1(shm_published, ts);
+        }
+        BRIDGE_TRACE1(scan_end, ts);
     }
 
     void Ros1Node::odometryCallback_(const nav_msgs::Odometry::ConstPtr& msg)
     {  
-        auto duration = msg->header.stamp - startupSystemTime_;
-        tf2::Transform pose;
-        pose.setOrigin(tf2::Vector3(msg->pose.pose.position.x, msg->pose.pose.position.y, msg->pose.pose.position.z)); 
-        tf2::Quaternion quat_tf;
-        tf2::fromMsg(msg->pose.pose.orientation, quat_tf);
-        pose.setRotation(quat_tf);
-        std::lock_guard<std::mutex> lkGuard(poseDataLock_);
-        pose_ = pose;
-        odomTimestamp_ = startupSteadyTime_ + duration.sec*1000 + duration.nsec/1000000;
+        const std::int64_t callbackStart = rpos::system::util::high_resolution_clock::get_time_in_ns();
+        RawOdometry raw;
+        raw.position[0] = msg->pose.pose.position.x;
+        raw.position[1] = msg->pose.pose.position.y;
+        raw.position[2] = msg->pose.pose.position.z;
+        raw.orientation[0] = msg->pose.pose.orientation.x;
+        raw.orientation[1] = msg->pose.pose.orientation.y;
+        raw.orientation[2] = msg->pose.pose.orientation.z;
+        raw.orientation[3] = msg->pose.pose.orientation.w;
+        raw.timestamp = steadyTimeUsOf_(msg->header.stamp);
+        rawOdometry_.store(raw);
+
+        BaseVelocity velocity;
+        velocity.v[0] = msg->twist.twist.linear.x;
+        velocity.v[1] = msg->twist.twist.linear.y;
+        velocity.v[2] = msg->twist.twist.angular.z;
+        odomVelocity_.store(velocity);
+        if (actuationProbeActive_.load(std::memory_order_acquire))
+            checkActuation_(velocity.v, rpos::system::util::high_resolution_clock::get_time_in_us());
+
+        odometryCallbackCost_.push(rpos::system::util::high_resolution_clock::get_time_in_ns() - callbackStart);
     }
     
     void Ros1Node::deadReckonCallback_(const geometry_msgs::Vector3Stamped::ConstPtr& msg)
     {
-        auto duration = msg->header.stamp - startupSystemTime_;
+        std::int64_t ts = steadyTimeUsOf_(msg->header.stamp);
         std::lock_guard<std::mutex> lkGuard(poseDataLock_);
-        deadreckon_.emplace_back(msg->vector.x, msg->vector.y,msg->vector.z);
-        odomTimestamp_ = startupSteadyTime_ + duration.sec*1000 + duration.nsec/1000000;
+        deadreckon_.push_back(msg->vector.x, msg->vector.y, msg->vector.z);
+        odomTimestamp_ = ts;
+    }
+
+    void Ros1Node::imuCallback_(const sensor_msgs::Imu::ConstPtr& msg)
+    {
+        const double gyro[3] = { msg->angular_velocity.x, msg->angular_velocity.y, msg->angular_velocity.z };
+
+        // integrate with the previous rate over the stamp interval, gaps longer than a second are not integrated
+        if (!imuStamp_.isZero())
+        {
+            double dt = (msg->header.stamp - imuStamp_).toSec();
+            if (dt > 0.0 && dt < 1.0)
+            {
+                ImuSample previous;
+                imuSample_.load(previous);
+                for (int axis = 0; axis < 3; axis++)
+                    gyroIntegral_[axis] += 0.5 * (previous.gyro[axis] + gyro[axis]) * dt;
+            }
+        }
+        imuStamp_ = msg->header.stamp;
+
+        ImuSample sample;
+        sample.acc[0] = msg->linear_acceleration.x;
+        sample.acc[1] = msg->linear_acceleration.y;
+        sample.acc[2] = msg->linear_acceleration.z;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            sample.gyro[axis] = gyro[axis];
+            sample.gyroIntegral[axis] = gyroIntegral_[axis];
+        }
+        imuSample_.store(sample);
+        if (imuFusionEnabled_)
+            fusionSignal_.notify_one();
+    }
+
+    void Ros1Node::fusionThread_()
+    {
+        std::uint32_t imuSequence = 0;
+        YawFusion fusion(imuFusionTimeConstant_);
+
+        std::unique_lock<std::mutex> lk(fusionLock_);
+        while (fusionWorking_.load())
+        {
+            // the notification is not serialized with the imu callback, so do not wait longer than a few samples
+            fusionSignal_.wait_for(lk, std::chrono::milliseconds(10), [&] {
+                return imuSample_.sequence() != imuSequence || !fusionWorking_.load();
+            });
+            if (imuSample_.sequence() == imuSequence)
+                continue;
+
+            ImuSample imu;
+            imuSequence = imuSample_.load(imu);
+            RawOdometry raw;
+            if (!rawOdometry_.load(raw))
+                continue;
+
+            Se2Pose odom = Se2Pose::fromQuaternion(raw.position[0], raw.position[1],
+                raw.orientation[0], raw.orientation[1], raw.orientation[2], raw.orientation[3]);
+            // differenced inside the fusion, so the integral has to stay in double however large it grows
+            if (!fusion.step(odom, imu.gyroIntegral[2], rpos::system::util::high_resolution_clock::get_time_in_us()))
+                continue;
+
+            FusedPose fusedPose;
+            fusedPose.x = fusion.fused().x();
+            fusedPose.y = fusion.fused().y();
+            fusedPose.yaw = fusion.fused().yaw();
+            fusedPose.timestamp = raw.timestamp;
+            fusedPose_.store(fusedPose);
+        }
+    }
+
+    void Ros1Node::stopFusion_()
+    {
+        {
+            std::lock_guard<std::mutex> lkGuard(fusionLock_);
+            fusionWorking_.store(false);
+        }
+        fusionSignal_.notify_one();
+        if (fusionWorker_.joinable())
+            fusionWorker_.join();
+    }
+
+    void Ros1Node::rangeCallback_(const sensor_msgs::Range::ConstPtr& msg, int sensorId)
+    {
+        // -Inf / +Inf mean too close / nothing detected (REP 117), both are reported as invalid at the range limits
+        RangeSample sample;
+        sample.valid = std::isfinite(msg->range) && msg->range >= msg->min_range && msg->range <= msg->max_range;
+        sample.dist = sample.valid ? msg->range : (msg->range < msg->min_range ? msg->min_range : msg->max_range);
+        sample.receivedTime = rpos::system::util::high_resolution_clock::get_time_in_ms();
+        rangeSamples_[sensorId].store(sample);
+    }
+
+    void Ros1Node::batteryCallback_(const sensor_msgs::BatteryState::ConstPtr& msg)
+    {
+        // percentage is in [0, 1], NaN if it is not measured
+        if (std::isfinite(msg->percentage))
+            baseStatus_.battery_percentage = std::min(std::max(int(std::lround(msg->percentage * 100)), 0), 100);
+        baseStatus_.isCharging = (msg->power_supply_status == sensor_msgs::BatteryState::POWER_SUPPLY_STATUS_CHARGING);
+        baseStatusSnapshot_.store(baseStatus_);
+    }
+
+    void Ros1Node::dockCallback_(const std_msgs::Bool::ConstPtr& msg)
+    {
+        baseStatus_.isDockLocked = msg->data;
+        baseStatusSnapshot_.store(baseStatus_);
+    }
+
+    void Ros1Node::clockCallback_(const rosgraph_msgs::Clock::ConstPtr& msg)
+    {
+        const std::int64_t now = std::int64_t(msg->clock.toNSec() / 1000);
+        std::int64_t previous;
+        {
+            std::lock_guard<std::mutex> lkGuard(simClockLock_);
+            previous = simClockUs_.exchange(now);
+        }
+        simClockSignal_.notify_all();
+
+        if (now < previous)
+        {
+            // the replay was restarted or looped
+            timeOffsetSteps_.fetch_add(1, std::memory_order_relaxed);
+            ROS_WARN("sim clock jumped back by %lld ms", (long long)((previous - now) / 1000));
+        }
     }
 
     void Ros1Node::generateTimeOffset_()
     {
-        startupSystemTime_ = ros::Time::now();
-        startupSteadyTime_ = rpos::system::util::high_resolution_clock::get_time_in_ms();
+        startupTimeOffset_ = sampleTimeOffset_();
+        timeOffset_.store(startupTimeOffset_);
+    }
+
+    std::int64_t Ros1Node::sampleTimeOffset_() const
+    {
+        // bracket ros::Time::now() between two steady clock reads, keep the tightest of a few tries
+        std::int64_t offset = 0;
+        std::int64_t bestWidth = -1;
+        for (int i = 0; i < 3; i++)
+        {
+            std::int64_t before = rpos::system::util::high_resolution_clock::get_time_in_ns();
+            std::int64_t rosNow = ros::Time::now().toNSec();
+            std::int64_t after = rpos::system::util::high_resolution_clock::get_time_in_ns();
+            if (bestWidth < 0 || after - before < bestWidth)
+            {
+                bestWidth = after - before;
+                offset = rosNow - (before + (after - before) / 2);
+            }
+        }
+        return offset;
+    }
+
+    void Ros1Node::clockThread_()
+    {
+        const auto interval = std::chrono::microseconds(std::int64_t(clockSyncInterval_ * 1000000));
+        // filtered relative to the startup offset, the absolute offset does not fit a double at ns resolution
+        double filtered = double(timeOffset_.load() - startupTimeOffset_);
+
+        std::unique_lock<std::mutex> lk(clockLock_);
+        while (clockWorking_)
+        {
+            clockSignal_.wait_for(lk, interval, [this] { return !clockWorking_; });
+            if (!clockWorking_)
+                break;
+
+            std::int64_t sample = sampleTimeOffset_() - startupTimeOffset_;
+            if (std::llabs(sample - std::int64_t(filtered)) > kClockStepThreshold)
+            {
+                // the ros clock was stepped (ntp step, sim time reset), follow it at once
+                filtered = double(sample);
+                timeOffsetSteps_.fetch_add(1, std::memory_order_relaxed);
+                ROS_WARN("ros clock stepped by %lld ms", (long long)((sample + startupTimeOffset_ - timeOffset_.load()) / 1000000));
+            }
+            else
+            {
+                filtered += kClockOffsetFilterGain * (sample - filtered);
+            }
+            timeOffset_.store(startupTimeOffset_ + std::int64_t(filtered), std::memory_order_relaxed);
+        }
+    }
+
+    void Ros1Node::stopClockSync_()
+    {
+        {
+            std::lock_guard<std::mutex> lkGuard(clockLock_);
+            clockWorking_ = false;
+        }
+        clockSignal_.notify_one();
+        if (clockWorker_.joinable())
+            clockWorker_.join();
+    }
+
+    std::int64_t Ros1Node::steadyTimeUsOf_(const ros::Time& stamp) const
+    {
+        return (std::int64_t(stamp.toNSec()) - timeOffset_.load(std::memory_order_relaxed)) / 1000;
     }
 
     bool Ros1Node::ensureSharedMemoryTopic_()
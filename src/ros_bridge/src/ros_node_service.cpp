@@ -1,9 +1,14 @@
 #include "ros_node_service.h"
+#include "trace_probes.h"
 #if ROS_DISTRO_VERSION == 1 
 #include "ros1_node.h"
 #endif  
 #include <rpos/system/util/log.h>
+#include <rpos/system/util/time_util.h>
 #include <geometry_msgs/Twist.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <sensor_msgs/JointState.h>
+#include <algorithm>
 #include <thread>
 #include <chrono>
 #include <cmath>
@@ -19,6 +24,11 @@ namespace rp { namespace slamware { namespace utils {
     template <typename RosHandlerT>
     RosNodeService<RosHandlerT>::RosNodeService(int argc, char** argv)
         : initEstimationFlag_(true)
+        , motionWorking_(false)
+        , motionPending_(false)
+        , pendingMotionTime_(0)
+        , coalescedMotions_(0)
+        , reflexStops_(0)
     {
         this->template provides<IRosNode>();
         rosNode_.reset(new RosHandlerT(argc, argv, "slamware_ros_bridge_node"));
@@ -40,15 +50,64 @@ namespace rp { namespace slamware { namespace utils {
         logger.info_out("ros node service thread begin, lidar topic:%s, odom topic:%s, velocity command topic:%s", 
             config_.scan_sub_topic.c_str(),config_.odometry_sub_topic.c_str(), config_.velocity_pub_topic.c_str());
 
-        rosNode_->subscribe(config_.scan_sub_topic, 1, MsgType::MsgTypeScan);
+        if (!config_.record_path.empty() || !config_.flight_recorder_path.empty())
+        {
+            SessionRecorder::Options recordOptions;
+            recordOptions.path = config_.record_path;
+            recordOptions.segmentSize = std::uint64_t(config_.record_segment_size) << 20;
+            recordOptions.spaceLimit = std::uint64_t(config_.record_space_limit) << 20;
+            recordOptions.queueSize = config_.record_queue_size;
+            recordOptions.compactScans = config_.record_compact_scan;
+            recordOptions.io.bufferSize = size_t(std::max(config_.record_write_buffer_size, 1)) << 10;
+            recordOptions.io.bufferCount = size_t(std::max(config_.record_write_buffers, 2));
+            recordOptions.io.flushInterval = std::int64_t(config_.record_flush_interval * 1000000);
+            recordOptions.flight.path = config_.flight_recorder_path;
+            recordOptions.flight.duration = std::int64_t(config_.flight_recorder_duration * 1000000);
+            recordOptions.flight.capacity = size_t(config_.flight_recorder_size) << 20;
+            recordOptions.flight.scanGap = std::int64_t(config_.flight_recorder_scan_gap * 1000000);
+            recordOptions.flight.clientGap = std::int64_t(config_.flight_recorder_client_gap * 1000000);
+            recordOptions.flight.odometryJump = float(config_.flight_recorder_odometry_jump);
+            recordOptions.flight.rotationJump = float(config_.flight_recorder_rotation_jump);
+            if (recorder_.start(recordOptions))
+                rosNode_->setRecorder(&recorder_);
+        }
+
+        if(config_.is_multi_echo_scan){
+            rosNode_->subscribe(config_.scan_sub_topic, 1, MsgType::MsgTypeMultiEchoScan);
+        }
+        else{
+            rosNode_->subscribe(config_.scan_sub_topic, 1, MsgType::MsgTypeScan);
+        }
         if(config_.is_accumulated_odometry){
             rosNode_->subscribe(config_.odometry_sub_topic, 10, MsgType::MsgTypeOdometry);
         }
         else{
             rosNode_->subscribe(config_.odometry_sub_topic, 10, MsgType::MsgTypeDeadreckon);
         }
-        rosNode_->template advertise<geometry_msgs::Twist>(config_.velocity_pub_topic, 10, MsgType::MsgTypeVelocity);
+        if(!config_.imu_sub_topic.empty()){
+            rosNode_->subscribe(config_.imu_sub_topic, 50, MsgType::MsgTypeImu);
+        }
+        for (auto& topic : config_.range_sub_topics){
+            rosNode_->subscribe(topic, 5, MsgType::MsgTypeRange);
+        }
+        if(!config_.battery_sub_topic.empty()){
+            rosNode_->subscribe(config_.battery_sub_topic, 1, MsgType::MsgTypeBattery);
+        }
+        if(!config_.dock_sub_topic.empty()){
+            rosNode_->subscribe(config_.dock_sub_topic, 1, MsgType::MsgTypeDock);
+        }
+        if(config_.velocity_output == VelocityOutputTwistStamped){
+            rosNode_->template advertise<geometry_msgs::TwistStamped>(config_.velocity_pub_topic, 10, MsgType::MsgTypeVelocity);
+        }
+        else if(config_.velocity_output == VelocityOutputWheels){
+            rosNode_->template advertise<sensor_msgs::JointState>(config_.velocity_pub_topic, 10, MsgType::MsgTypeVelocity);
+        }
+        else{
+            rosNode_->template advertise<geometry_msgs::Twist>(config_.velocity_pub_topic, 10, MsgType::MsgTypeVelocity);
+        }
 
+        motionWorking_ = true;
+        motionPublisher_ = std::thread(std::bind(&RosNodeService<RosHandlerT>::motionThread_, this));
         return true;
     }
 
@@ -56,7 +115,15 @@ namespace rp { namespace slamware { namespace utils {
     bool RosNodeService<RosHandlerT>::onStop()
     {
 	    logger.info_out("ros service stop.");
+        {
+            std::lock_guard<std::mutex> lkGuard(motionLock_);
+            motionWorking_ = false;
+        }
+        motionSignal_.notify_one();
+        if (motionPublisher_.joinable())
+            motionPublisher_.join();
 	    rosNode_->clear();
+        recorder_.stop();
         return true;
     }
 
@@ -75,6 +142,66 @@ namespace rp { namespace slamware { namespace utils {
     template <typename RosHandlerT>
     void RosNodeService<RosHandlerT>::publishMotion(const rpos::message::base::MotionRequest& request)
     {
+        rosNode_->onMotionRequest(request);
+        recorder_.recordMotionRequest(request, rpos::system::util::high_resolution_clock::get_time_in_us());
+
+        rpos::message::base::MotionRequest guarded = request;
+        if (rosNode_->guardMotion(guarded))
+            reflexStops_.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lkGuard(motionLock_);
+            if (motionPending_)
+                coalescedMotions_.fetch_add(1, std::memory_order_relaxed);
+            pendingMotion_ = guarded;
+            pendingMotionTime_ = rpos::system::util::high_resolution_clock::get_time_in_us();
+            motionPending_ = true;
+            BRIDGE_TRACE1(motion_request, pendingMotionTime_);
+        }
+        motionSignal_.notify_one();
+    }
+
+    template <typename RosHandlerT>
+    void RosNodeService<RosHandlerT>::motionThread_()
+    {
+        std::unique_lock<std::mutex> lk(motionLock_);
+        while (true)
+        {
+            motionSignal_.wait(lk, [this] { return motionPending_ || !motionWorking_; });
+            if (!motionWorking_)
+                break;
+
+            rpos::message::base::MotionRequest request = pendingMotion_;
+            std::int64_t requestTime = pendingMotionTime_;
+            motionPending_ = false;
+            lk.unlock();
+
+            publishVelocity_(request, requestTime);
+            BRIDGE_TRACE1(motion_published, requestTime);
+            motionLatency_.push(rpos::system::util::high_resolution_clock::get_time_in_us() - requestTime);
+
+            lk.lock();
+        }
+    }
+
+    template <typename RosHandlerT>
+    void RosNodeService<RosHandlerT>::publishVelocity_(const rpos::message::base::MotionRequest& request, std::int64_t requestTime)
+    {
+        if (config_.velocity_output == VelocityOutputWheels)
+        {
+            // inverse of MotionRequest::createDualWheel
+            float halfSpan = float(config_.wheel_span) / 2;
+            sensor_msgs::JointState msg;
+            msg.header.stamp = rosNode_->rosTimeOf(requestTime);
+            msg.name.resize(2);
+            msg.name[0] = "left_wheel";
+            msg.name[1] = "right_wheel";
+            msg.velocity.resize(2);
+            msg.velocity[0] = request.vx() - request.omega() * halfSpan;
+            msg.velocity[1] = request.vx() + request.omega() * halfSpan;
+            rosNode_->template publish<sensor_msgs::JointState>(msg, MsgType::MsgTypeVelocity);
+            return;
+        }
+
         geometry_msgs::Twist msg;
         msg.linear.x = request.vx();
         msg.linear.y = request.vy();
@@ -82,6 +209,14 @@ namespace rp { namespace slamware { namespace utils {
         msg.angular.x = 0.0f;
         msg.angular.y = 0.0f;
         msg.angular.z = request.omega();
+        if (config_.velocity_output == VelocityOutputTwistStamped)
+        {
+            geometry_msgs::TwistStamped stamped;
+            stamped.header.stamp = rosNode_->rosTimeOf(requestTime);
+            stamped.twist = msg;
+            rosNode_->template publish<geometry_msgs::TwistStamped>(stamped, MsgType::MsgTypeVelocity);
+            return;
+        }
         rosNode_->template publish<geometry_msgs::Twist>(msg, MsgType::MsgTypeVelocity);
     }
 
@@ -93,7 +228,69 @@ namespace rp { namespace slamware { namespace utils {
         estimation->positionDifference.x() = odom.x();
         estimation->positionDifference.y() = odom.y();
         estimation->angularDifference = odom.z();
-        estimation.timestamp = timestamp;
+        estimation.timestamp = timestamp / 1000;    // the sdk message timestamp is in ms
+        // the odometry stamp is 0 until odometry arrives, the record is placed at the fetch time
+        recorder_.recordMovementEstimation(estimation.payload, rpos::system::util::high_resolution_clock::get_time_in_us());
+    }
+
+    template <typename RosHandlerT>
+    void RosNodeService<RosHandlerT>::getImuAllSensorData(rpos::message::imu::ImuAllSensorData& sensorData)
+    {
+        rosNode_->getImuAllSensorData(sensorData);
+    }
+
+    template <typename RosHandlerT>
+    void RosNodeService<RosHandlerT>::getExtendedSensorData(std::vector<PseudoBaseDevice::BaseSensorData>& extendedSensorData)
+    {
+        rosNode_->getExtendedSensorData(extendedSensorData);
+    }
+
+    template <typename RosHandlerT>
+    void RosNodeService<RosHandlerT>::getBaseStatus(PseudoBaseDevice::BaseStatusData& data)
+    {
+        rosNode_->getBaseStatus(data);
+    }
+
+    template <typename RosHandlerT>
+    void RosNodeService<RosHandlerT>::sleepFor(std::int64_t us)
+    {
+        rosNode_->sleepFor(us);
+    }
+
+    template <typename RosHandlerT>
+    void RosNodeService<RosHandlerT>::reportStats()
+    {
+        LatencyStat::Summary motion = motionLatency_.takeSummary();
+        logger.info_out("motion commands: published %llu, coalesced %llu, command to publish latency avg %.1f us, max %lld us",
+            (unsigned long long)motion.count, (unsigned long long)coalescedMotions_.exchange(0), motion.average, (long long)motion.max);
+
+        LatencyStat::Summary odometryCost = rosNode_->takeOdometryCallbackCost();
+        logger.info_out("odometry callback: %llu calls, cost avg %.0f ns, max %lld ns",
+            (unsigned long long)odometryCost.count, odometryCost.average, (long long)odometryCost.max);
+
+        std::uint64_t clockSteps;
+        std::int64_t clockDrift = rosNode_->takeClockDrift(clockSteps);
+        logger.info_out("ros clock offset drift since startup %lld us, steps %llu", (long long)clockDrift, (unsigned long long)clockSteps);
+
+        logger.info_out("reflex stop scaled %llu motion commands", (unsigned long long)reflexStops_.exchange(0));
+
+        if (recorder_.isRecording())
+            logger.info_out("recorder: written %llu, dropped %llu", (unsigned long long)recorder_.takeWritten(), (unsigned long long)recorder_.takeDropped());
+        if (AsyncSegmentedWriteStream* io = recorder_.io())
+        {
+            std::uint64_t bytes = io->takeWrittenBytes();
+            LatencyStat::Summary writes = io->takeWriteCost();
+            LatencyStat::Summary stalls = io->takeStalls();
+            double writeSeconds = writes.average * writes.count * 1e-6;
+            logger.info_out("recorder io: %.1f MB in %llu writes, %.1f MB/s while writing, write max %.1f ms, flushes %llu, writer stalls %llu, stall max %.1f ms",
+                bytes / 1048576.0, (unsigned long long)writes.count, writeSeconds > 0 ? bytes / 1048576.0 / writeSeconds : 0.0, writes.max * 1e-3,
+                (unsigned long long)io->takeFlushes(), (unsigned long long)stalls.count, stalls.max * 1e-3);
+        }
+
+        std::uint64_t actuationTimeouts;
+        LatencyHistogram::Summary actuation = rosNode_->takeActuationLatency(actuationTimeouts);
+        logger.info_out("command to odometry latency: samples %llu, p50 %d ms, p90 %d ms, p99 %d ms, max %d ms, no response %llu",
+            (unsigned long long)actuation.count, actuation.p50Ms, actuation.p90Ms, actuation.p99Ms, actuation.maxMs, (unsigned long long)actuationTimeouts);
     }
 
     template <typename RosHandlerT>
@@ -0,0 +1,470 @@
+#include "scan_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+    using rpos::system::encoding::StreamPosition;
+
+    // bounds the reference memory, far beyond the beams of any lidar
+    const int kMaxGridIndex = 1 << 20;
+    const int kMaxRange = 1 << 24;
+    const std::uint32_t kMaxPoints = 1 << 20;
+    // body bytes of a point at most: index gap, range residual and layer varints, quality,
+    // valid flag and raw angle
+    const size_t kMaxBytesPerPoint = 5 + 5 + 5 + 1 + 1 + sizeof(float);
+
+    const StreamPosition kWholeBuffer = StreamPosition(rpos::system::encoding::StreamPositionBegin | rpos::system::encoding::StreamPositionEnd);
+
+    float gridAngle(float base, float step, int index)
+    {
+        return float(double(base) + double(step) * index);
+    }
+
+    void putVarint(std::vector<std::uint8_t>& out, std::uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(std::uint8_t(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(std::uint8_t(value));
+    }
+
+    bool getVarint(const std::uint8_t*& p, const std::uint8_t* end, std::uint32_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            if (p == end)
+                return false;
+            std::uint8_t byte = *p++;
+            value |= std::uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    std::uint32_t zigzag(int value)
+    {
+        return (std::uint32_t(value) << 1) ^ std::uint32_t(value >> 31);
+    }
+
+    int unzigzag(std::uint32_t value)
+    {
+        return int(value >> 1) ^ -int(value & 1);
+    }
+
+    void putFloat(std::vector<std::uint8_t>& out, float value)
+    {
+        const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&value);
+        out.insert(out.end(), p, p + sizeof(float));
+    }
+
+    bool getFloat(const std::uint8_t*& p, const std::uint8_t* end, float& value)
+    {
+        if (size_t(end - p) < sizeof(float))
+            return false;
+        std::memcpy(&value, p, sizeof(float));
+        p += sizeof(float);
+        return true;
+    }
+
+    int quantizeRange(float dist)
+    {
+        if (!(dist > 0))
+            return 0;
+        double q = std::floor(dist / rp::slamware::utils::ScanCodec::RangeResolution + 0.5);
+        return int(std::min<double>(q, kMaxRange));
+    }
+
+}
+
+namespace rp { namespace slamware { namespace utils {
+
+    const float ScanCodec::RangeResolution = 0.001f;
+    const float ScanCodec::AngleTolerance = 0.001f;
+    const std::uint8_t ScanCodec::Version;
+
+    ScanCodec::ScanCodec()
+        : hasReference_(false)
+        , sequence_(0)
+        , base_(0.f)
+        , step_(0.f)
+    {
+    }
+
+    int ScanCodec::predict_(bool temporal, int index, int previous) const
+    {
+        if (temporal && index >= 0 && size_t(index) < reference_.size() && reference_[index] >= 0)
+            return reference_[index];
+        return previous;
+    }
+
+    void ScanCodec::updateReference_(const std::vector<int>& indexes, const std::vector<int>& ranges)
+    {
+        if (indexes.empty() && !ranges.empty())
+        {
+            hasReference_ = false;
+            reference_.clear();
+            return;
+        }
+
+        // a multi echo beam is referenced by its first point
+        nextReference_.assign(indexes.empty() ? 0 : indexes.back() + 1, -1);
+        for (size_t i = 0; i < indexes.size(); i++)
+        {
+            if (nextReference_[indexes[i]] < 0)
+                nextReference_[indexes[i]] = ranges[i];
+        }
+        reference_.swap(nextReference_);
+        hasReference_ = true;
+    }
+
+    ScanEncoder::ScanEncoder(int keyframeInterval)
+        : keyframeInterval_(std::max(keyframeInterval, 1))
+        , sinceKeyframe_(0)
+    {
+    }
+
+    void ScanEncoder::reset()
+    {
+        hasReference_ = false;
+        reference_.clear();
+    }
+
+    void ScanEncoder::encode(const rpos::message::lidar::LidarScan& scan, std::vector<std::uint8_t>& frame)
+    {
+        const size_t count = scan.size();
+        bool keyframe = !hasReference_ || sinceKeyframe_ + 1 >= keyframeInterval_;
+        bool grid = true;
+        if (keyframe || !fitGrid_(scan, base_, step_))
+        {
+            keyframe = true;
+            grid = findGrid_(scan);
+        }
+        if (!grid)
+            indexes_.clear();
+        sinceKeyframe_ = keyframe ? 0 : sinceKeyframe_ + 1;
+        sequence_++;
+
+        std::uint8_t flags = 0;
+        if (keyframe)
+            flags |= FlagKeyframe;
+        if (grid)
+            flags |= FlagGrid;
+
+        layers_.clear();
+        for (const rpos::message::lidar::LidarScanPoint& point : scan)
+        {
+            if (!point.valid)
+                flags |= FlagInvalid;
+            if (!point.layer.empty())
+                flags |= FlagLayers;
+        }
+
+        // planes of similar bytes, so the runs are long
+        body_.clear();
+        if (grid)
+        {
+            int previous = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                putVarint(body_, std::uint32_t(indexes_[i] - previous));
+                previous = indexes_[i];
+            }
+        }
+
+        ranges_.resize(count);
+        int previous = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            ranges_[i] = quantizeRange(scan[i].dist);
+            putVarint(body_, zigzag(ranges_[i] - predict_(!keyframe, grid ? indexes_[i] : -1, previous)));
+            previous = ranges_[i];
+        }
+
+        for (const rpos::message::lidar::LidarScanPoint& point : scan)
+            body_.push_back(point.quality);
+
+        if (flags & FlagLayers)
+        {
+            for (const rpos::message::lidar::LidarScanPoint& point : scan)
+            {
+                // layers are few, a linear search beats a map
+                size_t layer = std::find(layers_.begin(), layers_.end(), point.layer) - layers_.begin();
+                if (layer == layers_.size())
+                    layers_.push_back(point.layer);
+                putVarint(body_, std::uint32_t(layer));
+            }
+        }
+
+        if (flags & FlagInvalid)
+        {
+            for (const rpos::message::lidar::LidarScanPoint& point : scan)
+                body_.push_back(point.valid ? 1 : 0);
+        }
+
+        if (!grid)
+        {
+            for (const rpos::message::lidar::LidarScanPoint& point : scan)
+                putFloat(body_, point.angle);
+        }
+
+        updateReference_(indexes_, ranges_);
+
+        // kept raw when the runs do not pay for the escapes
+        rle_.reset();
+        compressed_.resize(rle_.estimateEncodedSize(body_.data(), body_.size()));
+        size_t consumed = 0;
+        size_t compressedSize = 0;
+        if (!body_.empty()
+            && rle_.encode(body_.data(), body_.size(), compressed_.data(), compressed_.size(), kWholeBuffer, consumed, compressedSize)
+            && consumed == body_.size() && compressedSize < body_.size())
+            flags |= FlagRle;
+
+        frame.clear();
+        frame.push_back(Version);
+        frame.push_back(flags);
+        frame.push_back(sequence_);
+        putVarint(frame, std::uint32_t(count));
+        if (grid)
+        {
+            putFloat(frame, base_);
+            putFloat(frame, step_);
+        }
+        if (flags & FlagLayers)
+        {
+            putVarint(frame, std::uint32_t(layers_.size()));
+            for (const std::string& layer : layers_)
+            {
+                putVarint(frame, std::uint32_t(layer.size()));
+                frame.insert(frame.end(), layer.begin(), layer.end());
+            }
+        }
+        putVarint(frame, std::uint32_t(body_.size()));
+        if (flags & FlagRle)
+            frame.insert(frame.end(), compressed_.begin(), compressed_.begin() + compressedSize);
+        else
+            frame.insert(frame.end(), body_.begin(), body_.end());
+    }
+
+    bool ScanEncoder::fitGrid_(const rpos::message::lidar::LidarScan& scan, float base, float step)
+    {
+        if (!(step > 0))
+            return false;
+
+        indexes_.resize(scan.size());
+        int previous = 0;
+        for (size_t i = 0; i < scan.size(); i++)
+        {
+            const double k = std::floor((double(scan[i].angle) - base) / step + 0.5);
+            if (!(k >= previous && k < kMaxGridIndex))
+                return false;
+            const int index = int(k);
+            if (std::fabs(gridAngle(base, step, index) - scan[i].angle) > AngleTolerance)
+                return false;
+            indexes_[i] = index;
+            previous = index;
+        }
+        return true;
+    }
+
+    bool ScanEncoder::findGrid_(const rpos::message::lidar::LidarScan& scan)
+    {
+        if (scan.empty())
+        {
+            base_ = 0.f;
+            step_ = 1.f;
+            indexes_.clear();
+            return true;
+        }
+
+        // the smallest gap between two beams, then refined point after point, as the rounding of
+        // the float angles makes a single gap too coarse to index a whole revolution
+        const float front = scan.front().angle;
+        double estimate = std::numeric_limits<double>::infinity();
+        for (size_t i = 1; i < scan.size(); i++)
+        {
+            const double gap = double(scan[i].angle) - scan[i - 1].angle;
+            if (gap > AngleTolerance)
+                estimate = std::min(estimate, gap);
+        }
+        if (!std::isfinite(estimate))
+            estimate = 1.0;
+        for (size_t i = 1; i < scan.size(); i++)
+        {
+            const double k = std::floor((double(scan[i].angle) - front) / estimate + 0.5);
+            if (k >= 1)
+                estimate = (double(scan[i].angle) - front) / k;
+        }
+        const float step = float(estimate);
+
+        // anchored near 0 rather than on the first point, so the next scans fit the grid even when
+        // their first beams were dropped
+        const float base = float(front - std::floor(double(front) / step) * step);
+        if (fitGrid_(scan, base, step))
+        {
+            base_ = base;
+            step_ = step;
+            return true;
+        }
+        if (!fitGrid_(scan, front, step))
+            return false;
+        base_ = front;
+        step_ = step;
+        return true;
+    }
+
+    ScanDecoder::ScanDecoder()
+    {
+    }
+
+    void ScanDecoder::reset()
+    {
+        hasReference_ = false;
+        reference_.clear();
+    }
+
+    bool ScanDecoder::decode(const std::uint8_t* frame, size_t size, rpos::message::lidar::LidarScan& scan)
+    {
+        const std::uint8_t* p = frame;
+        const std::uint8_t* end = frame + size;
+        // a frame that fails midway leaves no usable reference
+        const bool hadReference = hasReference_;
+        hasReference_ = false;
+
+        if (size < 3 || p[0] != Version)
+            return false;
+        const std::uint8_t flags = p[1];
+        const std::uint8_t sequence = p[2];
+        p += 3;
+        const bool keyframe = (flags & FlagKeyframe) != 0;
+        const bool grid = (flags & FlagGrid) != 0;
+        if (!keyframe && (!hadReference || !grid || sequence != std::uint8_t(sequence_ + 1)))
+            return false;
+
+        std::uint32_t count;
+        if (!getVarint(p, end, count) || count > kMaxPoints)
+            return false;
+        float base = 0.f;
+        float step = 0.f;
+        if (grid && (!getFloat(p, end, base) || !getFloat(p, end, step)))
+            return false;
+
+        layers_.clear();
+        if (flags & FlagLayers)
+        {
+            std::uint32_t layerCount;
+            if (!getVarint(p, end, layerCount) || layerCount > count)
+                return false;
+            for (std::uint32_t i = 0; i < layerCount; i++)
+            {
+                std::uint32_t length;
+                if (!getVarint(p, end, length) || length > size_t(end - p))
+                    return false;
+                layers_.push_back(std::string(reinterpret_cast<const char*>(p), length));
+                p += length;
+            }
+        }
+
+        // the size comes from the stream, bound it before allocating
+        std::uint32_t bodySize;
+        if (!getVarint(p, end, bodySize) || bodySize > count * kMaxBytesPerPoint)
+            return false;
+        if (flags & FlagRle)
+        {
+            rle_.reset();
+            body_.resize(bodySize);
+            size_t consumed = 0;
+            size_t decodedSize = 0;
+            if (!rle_.encode(p, end - p, body_.data(), body_.size(), kWholeBuffer, consumed, decodedSize) || decodedSize != bodySize)
+                return false;
+        }
+        else
+        {
+            if (bodySize > size_t(end - p))
+                return false;
+            body_.assign(p, p + bodySize);
+        }
+        p = body_.data();
+        end = body_.data() + body_.size();
+
+        indexes_.clear();
+        if (grid)
+        {
+            indexes_.resize(count);
+            std::uint32_t index = 0;
+            for (std::uint32_t i = 0; i < count; i++)
+            {
+                std::uint32_t gap;
+                if (!getVarint(p, end, gap) || gap >= std::uint32_t(kMaxGridIndex) - index)
+                    return false;
+                index += gap;
+                indexes_[i] = int(index);
+            }
+        }
+
+        ranges_.resize(count);
+        int previous = 0;
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            std::uint32_t residual;
+            if (!getVarint(p, end, residual))
+                return false;
+            ranges_[i] = predict_(!keyframe, grid ? indexes_[i] : -1, previous) + unzigzag(residual);
+            previous = ranges_[i];
+        }
+
+        const size_t fixedPlanes = count + ((flags & FlagInvalid) ? count : 0) + (grid ? 0 : count * sizeof(float));
+        if (size_t(end - p) < fixedPlanes)
+            return false;
+
+        scan.resize(count);
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            rpos::message::lidar::LidarScanPoint& point = scan[i];
+            point.dist = ranges_[i] * RangeResolution;
+            point.quality = *p++;
+            point.valid = true;
+            point.layer.clear();
+            if (grid)
+                point.angle = gridAngle(base, step, indexes_[i]);
+        }
+
+        if (flags & FlagLayers)
+        {
+            for (std::uint32_t i = 0; i < count; i++)
+            {
+                std::uint32_t layer;
+                if (!getVarint(p, end, layer) || layer >= layers_.size())
+                    return false;
+                scan[i].layer = layers_[layer];
+            }
+            if (size_t(end - p) < fixedPlanes - count)
+                return false;
+        }
+
+        if (flags & FlagInvalid)
+        {
+            for (std::uint32_t i = 0; i < count; i++)
+                scan[i].valid = *p++ != 0;
+        }
+
+        if (!grid)
+        {
+            for (std::uint32_t i = 0; i < count; i++)
+                getFloat(p, end, scan[i].angle);
+        }
+
+        base_ = base;
+        step_ = step;
+        sequence_ = sequence;
+        updateReference_(indexes_, ranges_);
+        return true;
+    }
+
+}}}
@@ -0,0 +1,55 @@
+#include "scan_converter.h"
+#include <rpos/system/util/time_util.h>
+
+namespace rp { namespace slamware { namespace utils {
+
+    ScanConverter::ScanConverter()
+        : echoSelection_(EchoSelectionFirst)
+        , reflexGuard_(nullptr)
+    {}
+
+    int ScanConverter::selectEcho(const std::vector<float>& echoes, const std::vector<float>* intensities, float rangeMin, float rangeMax) const
+    {
+        if (intensities && intensities->size() != echoes.size())
+            intensities = nullptr;
+
+        int selected = -1;
+        for (int e = 0; e < (int)echoes.size(); e++)
+        {
+            if (echoes[e] < rangeMin || echoes[e] > rangeMax)
+                continue;
+
+            if (selected < 0)
+            {
+                selected = e;
+                if (echoSelection_ == EchoSelectionFirst)
+                    break;
+                continue;
+            }
+
+            switch (echoSelection_)
+            {
+            case EchoSelectionLast:
+                selected = e;
+                break;
+            case EchoSelectionNearest:
+                if (echoes[e] < echoes[selected])
+                    selected = e;
+                break;
+            case EchoSelectionStrongest:
+                if (intensities && (*intensities)[e] > (*intensities)[selected])
+                    selected = e;
+                break;
+            default:
+                break;
+            }
+        }
+        return selected;
+    }
+
+    void ScanConverter::commitReflexScan_()
+    {
+        reflexGuard_->commitScan(rpos::system::util::high_resolution_clock::get_time_in_us());
+    }
+
+}}}
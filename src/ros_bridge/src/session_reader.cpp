@@ -0,0 +1,39 @@
+#include "session_reader.h"
+#include "session_recorder.h"
+#include <rpos/system/io/segmented_loop_files_read_stream.h>
+#include <boost/make_shared.hpp>
+
+namespace rp { namespace slamware { namespace utils {
+
+    bool SessionReader::open(const std::string& directory)
+    {
+        close();
+
+        rpos::system::io::SegmentedLoopFilesReadStream::Options options;
+        options.enableLoopSave = false;
+        options.path = directory;
+        options.ext = SessionRecorder::SegmentExtension;
+        options.spaceConstraint = 0;
+        options.quantityConstraint = 0;
+        options.splitSize = 0;
+        boost::shared_ptr<rpos::system::io::SegmentedLoopFilesReadStream> segments = boost::make_shared<rpos::system::io::SegmentedLoopFilesReadStream>(options);
+
+        // a recording directory holds a single segmented stream
+        std::vector<boost::shared_ptr<rpos::system::io::SegmentedLoopFilesReadStream::FileInfo> > files = segments->getFileList();
+        if (files.empty() || !segments->open(files.front()->dateStr, files.front()->timeStr))
+            return false;
+
+        stream_ = segments;
+        messages_ = boost::make_shared<SessionReadStream>(stream_);
+        return true;
+    }
+
+    void SessionReader::close()
+    {
+        messages_.reset();
+        if (stream_)
+            stream_->close();
+        stream_.reset();
+    }
+
+}}}
@@ -0,0 +1,264 @@
+#include "session_recorder.h"
+#include <rpos/message/diagnosis/lidar_messages_serialization.h>
+#include <rpos/message/diagnosis/base_messages_serialization.h>
+#include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <functional>
+
+namespace {
+
+    // fixed size lock-free queues index their nodes with 16 bits
+    const size_t kMaxQueueSize = 65534;
+
+    // the writer polls the queue, so the hot paths never touch a lock or a condition variable
+    const std::chrono::milliseconds kWriterIdle(10);
+
+    std::string startTimeName()
+    {
+        std::time_t now = std::time(nullptr);
+        std::tm local;
+        localtime_r(&now, &local);
+        char name[32];
+        std::strftime(name, sizeof(name), "%Y%m%d_%H%M%S", &local);
+        return name;
+    }
+
+}
+
+namespace rp { namespace slamware { namespace utils {
+
+    rpos::system::util::LogScope SessionRecorder::logger("srv.session_recorder");
+
+    const char* const SessionRecorder::ScanTopic = "lidar.scan";
+    const char* const SessionRecorder::CompactScanTopic = "lidar.scan.compact";
+    const char* const SessionRecorder::MovementEstimationTopic = "base.movement_estimation";
+    const char* const SessionRecorder::MotionRequestTopic = "base.motion_request";
+    const char* const SessionRecorder::SegmentExtension = "rec";
+
+    SessionRecorder::SessionRecorder()
+        : working_(false)
+        , written_(0)
+        , dropped_(0)
+        , compactScans_(false)
+    {
+    }
+
+    SessionRecorder::~SessionRecorder()
+    {
+        stop();
+        releaseRecords_();
+    }
+
+    bool SessionRecorder::start(const Options& options)
+    {
+        stop();
+        releaseRecords_();
+
+        directory_.clear();
+        ioStream_.reset();
+        if (!options.path.empty() && !openSegments_(options))
+            return false;
+        if (!options.flight.path.empty())
+            flightRecorder_.start(options.flight);
+        if (!messageStream_ && !flightRecorder_.isEnabled())
+            return false;
+
+        const size_t queueSize = std::min(std::max<size_t>(options.queueSize, 1), kMaxQueueSize);
+        freeRecords_.reset(new RecordQueue(queueSize));
+        pendingRecords_.reset(new RecordQueue(queueSize));
+        for (size_t i = 0; i < queueSize; i++)
+            freeRecords_->push(new Record());
+
+        working_.store(true);
+        writerWorker_ = std::thread(std::bind(&SessionRecorder::writerThread_, this));
+        return true;
+    }
+
+    bool SessionRecorder::openSegments_(const Options& options)
+    {
+        const std::string directory = options.path + "/" + startTimeName();
+        boost::system::error_code ec;
+        boost::filesystem::create_directories(directory, ec);
+        if (ec)
+        {
+            logger.error_out("failed to create recording directory %s: %s", directory.c_str(), ec.message().c_str());
+            return false;
+        }
+
+        rpos::system::io::SegmentedLoopFilesWriteStream::Options segmentOptions;
+        segmentOptions.enableLoopSave = true;
+        segmentOptions.path = directory;
+        segmentOptions.ext = SegmentExtension;
+        segmentOptions.splitSize = int(std::max<std::uint64_t>(options.segmentSize, 1));
+        segmentOptions.spaceConstraint = std::max(options.spaceLimit, options.segmentSize);
+        segmentOptions.quantityConstraint = int(segmentOptions.spaceConstraint / segmentOptions.splitSize) + 1;
+        messageStream_ = boost::make_shared<rpos::system::io::SegmentedLoopFilesWriteStream>(segmentOptions);
+        if (!messageStream_->open())
+        {
+            logger.error_out("failed to open recording segments in %s", directory.c_str());
+            messageStream_.reset();
+            return false;
+        }
+        ioStream_ = boost::make_shared<AsyncSegmentedWriteStream>(messageStream_, options.io);
+        writer_ = boost::make_shared<SessionWriteStream>(ioStream_);
+        compactScans_ = options.compactScans;
+        scanEncoder_.reset();
+        directory_ = directory;
+        logger.info_out("recording to %s", directory_.c_str());
+        return true;
+    }
+
+    void SessionRecorder::stop()
+    {
+        working_.store(false);
+        if (writerWorker_.joinable())
+            writerWorker_.join();
+        flightRecorder_.stop();
+    }
+
+    bool SessionRecorder::requestDump(const std::string& reason)
+    {
+        if (!flightRecorder_.isEnabled())
+            return false;
+        flightRecorder_.requestDump(reason);
+        return true;
+    }
+
+    void SessionRecorder::recordScan(const rpos::message::lidar::LidarScan& scan, std::int64_t timestamp)
+    {
+        Record* record = acquire_();
+        if (!record)
+            return;
+        record->type = RecordTypeScan;
+        record->scan.timestamp = timestamp;
+        record->scan.payload.assign(scan.begin(), scan.end());
+        commit_(record);
+    }
+
+    void SessionRecorder::recordMovementEstimation(const rpos::message::base::MovementEstimation& estimation, std::int64_t timestamp)
+    {
+        Record* record = acquire_();
+        if (!record)
+            return;
+        record->type = RecordTypeMovementEstimation;
+        record->estimation.timestamp = timestamp;
+        record->estimation.payload = estimation;
+        commit_(record);
+    }
+
+    void SessionRecorder::recordMotionRequest(const rpos::message::base::MotionRequest& request, std::int64_t timestamp)
+    {
+        Record* record = acquire_();
+        if (!record)
+            return;
+        record->type = RecordTypeMotionRequest;
+        record->motion.timestamp = timestamp;
+        record->motion.payload = request;
+        commit_(record);
+    }
+
+    SessionRecorder::Record* SessionRecorder::acquire_()
+    {
+        if (!working_.load(std::memory_order_relaxed))
+            return nullptr;
+        Record* record = nullptr;
+        if (!freeRecords_->pop(record))
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return record;
+    }
+
+    void SessionRecorder::commit_(Record* record)
+    {
+        // both queues have room for every record, the push cannot fail
+        pendingRecords_->push(record);
+    }
+
+    void SessionRecorder::writerThread_()
+    {
+        while (true)
+        {
+            // read before draining, so the records committed before stop() are all written
+            const bool working = working_.load();
+            Record* record = nullptr;
+            while (pendingRecords_->pop(record))
+            {
+                write_(*record);
+                freeRecords_->push(record);
+            }
+            if (!working)
+                break;
+            if (flightRecorder_.isEnabled())
+                flightRecorder_.poll();
+            std::this_thread::sleep_for(kWriterIdle);
+        }
+
+        writer_.reset();
+        if (ioStream_)
+            ioStream_->close();
+        if (messageStream_)
+            messageStream_->close();
+        messageStream_.reset();
+    }
+
+    void SessionRecorder::write_(const Record& record)
+    {
+        switch (record.type)
+        {
+        case RecordTypeScan:
+            if (writer_ && compactScans_)
+            {
+                // the flight recorder ring stays in the plain encoding, a dump may start anywhere
+                scanEncoder_.encode(record.scan.payload, compactScan_.payload);
+                compactScan_.timestamp = record.scan.timestamp;
+                writer_->write(CompactScanTopic, compactScan_);
+                if (flightRecorder_.isEnabled())
+                    flightRecorder_.write(ScanTopic, record.scan);
+            }
+            else
+            {
+                write_(ScanTopic, record.scan);
+            }
+            break;
+        case RecordTypeMovementEstimation:
+            write_(MovementEstimationTopic, record.estimation);
+            break;
+        case RecordTypeMotionRequest:
+            write_(MotionRequestTopic, record.motion);
+            break;
+        }
+        written_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <typename PayloadT>
+    void SessionRecorder::write_(const char* topic, const rpos::message::Message<PayloadT>& message)
+    {
+        if (writer_)
+            writer_->write(topic, message);
+        if (flightRecorder_.isEnabled())
+            flightRecorder_.write(topic, message);
+    }
+
+    void SessionRecorder::releaseRecords_()
+    {
+        Record* record = nullptr;
+        if (pendingRecords_)
+        {
+            while (pendingRecords_->pop(record))
+                delete record;
+        }
+        if (freeRecords_)
+        {
+            while (freeRecords_->pop(record))
+                delete record;
+        }
+        pendingRecords_.reset();
+        freeRecords_.reset();
+    }
+
+}}}
@@ -0,0 +1,118 @@
+#include "session_stream.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+    const size_t kHeaderSize = sizeof(std::uint32_t) + sizeof(std::uint16_t) + sizeof(std::uint32_t);
+    const size_t kReadChunk = 64 * 1024;
+    // larger frames are taken as corrupted
+    const std::uint32_t kMaxBodySize = 64 * 1024 * 1024;
+
+    template <typename T>
+    void append(std::vector<std::uint8_t>& buffer, T value)
+    {
+        const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&value);
+        buffer.insert(buffer.end(), p, p + sizeof(T));
+    }
+
+    template <typename T>
+    T peek(const std::uint8_t* p)
+    {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        return value;
+    }
+
+}
+
+namespace rp { namespace slamware { namespace utils {
+
+    SessionWriteStream::SessionWriteStream(boost::shared_ptr<rpos::system::io::IStream> stream)
+        : stream_(stream)
+        , bytesWritten_(0)
+    {
+    }
+
+    SessionWriteStream::~SessionWriteStream()
+    {
+    }
+
+    void SessionWriteStream::writeMessage(const std::string& topic, const std::type_index&, const rpos::system::io::MemoryWriteStream& body, rpos::system::diagnosis::MessageWriteFlags)
+    {
+        // a single write per frame, so the segmented stream only splits between frames
+        frame_.clear();
+        append<std::uint32_t>(frame_, FrameMagic);
+        append<std::uint16_t>(frame_, std::uint16_t(topic.size()));
+        append<std::uint32_t>(frame_, std::uint32_t(body.size()));
+        frame_.insert(frame_.end(), topic.begin(), topic.end());
+        frame_.insert(frame_.end(), body.buffer(), body.buffer() + body.size());
+        stream_->write(frame_.data(), frame_.size());
+        bytesWritten_ += frame_.size();
+    }
+
+    SessionReadStream::SessionReadStream(boost::shared_ptr<rpos::system::io::IStream> stream)
+        : stream_(stream)
+        , begin_(0)
+        , end_(0)
+        , pending_(false)
+        , timestamp_(0)
+        , skippedBytes_(0)
+    {
+    }
+
+    bool SessionReadStream::hasNextMessage()
+    {
+        if (pending_)
+            return true;
+
+        while (fill_(kHeaderSize))
+        {
+            const std::uint8_t* header = buffer_.data() + begin_;
+            const std::uint16_t topicSize = peek<std::uint16_t>(header + sizeof(std::uint32_t));
+            const std::uint32_t bodySize = peek<std::uint32_t>(header + sizeof(std::uint32_t) + sizeof(std::uint16_t));
+            const bool valid = peek<std::uint32_t>(header) == SessionWriteStream::FrameMagic
+                && bodySize >= sizeof(rpos::message::message_timestamp_t) && bodySize <= kMaxBodySize;
+            if (!valid || !fill_(kHeaderSize + topicSize + bodySize))
+            {
+                // resync on the next magic
+                begin_++;
+                skippedBytes_++;
+                continue;
+            }
+
+            const std::uint8_t* topic = buffer_.data() + begin_ + kHeaderSize;
+            topic_.assign(reinterpret_cast<const char*>(topic), topicSize);
+            body_.assign(topic + topicSize, topic + topicSize + bodySize);
+            begin_ += kHeaderSize + topicSize + bodySize;
+
+            rpos::system::io::MemoryReadStream body(body_.data(), body_.size(), rpos::system::io::MemoryReadStream::MemoryReadStreamFlagBorrowBuffer);
+            rpos::system::diagnosis::serialization::read(body, timestamp_);
+            pending_ = true;
+            return true;
+        }
+        return false;
+    }
+
+    bool SessionReadStream::fill_(size_t size)
+    {
+        if (end_ - begin_ >= size)
+            return true;
+
+        // compact, then read until the buffer holds size bytes or the stream ends
+        buffer_.erase(buffer_.begin(), buffer_.begin() + begin_);
+        end_ -= begin_;
+        begin_ = 0;
+        while (end_ < size)
+        {
+            buffer_.resize(std::max(size, end_ + kReadChunk));
+            int n = stream_->read(buffer_.data() + end_, buffer_.size() - end_);
+            if (n <= 0)
+                break;
+            end_ += n;
+        }
+        buffer_.resize(end_);
+        return end_ >= size;
+    }
+
+}}}